@@ -0,0 +1,414 @@
+#include "BytecodeCache.h"
+
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    constexpr char MAGIC[4] = {'I', 'R', 'S', 'C'};
+
+    /** @brief FNV-1a, 64-bit; pass a previous result as hash to continue it over more bytes. */
+    uint64_t hashBytes(const std::string_view bytes, uint64_t hash = 0xcbf29ce484222325ull) {
+        for (const unsigned char c : bytes) {
+            hash ^= c;
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    constexpr size_t SECTION_ALIGN = 8;
+
+    /*
+     * Image layout (host byte order; the cache never leaves the machine that wrote it):
+     * ImageHeader, then the sections it points to, each 8-byte aligned: ImageConstant[],
+     * ImageFunction[], ImageCallSite[] of all chunks, uint32_t code of all chunks, the
+     * bytes of names, strings and parameter types, ImageImport[], and in snapshots ImageGlobal[].
+     */
+
+    /** @brief A chunk as ranges of the call site and code sections. */
+    struct ImageChunk {
+        uint32_t codeStart;
+        uint32_t codeCount;
+        uint32_t callSiteStart;
+        uint32_t callSiteCount;
+    };
+
+    struct ImageHeader {
+        char magic[4];
+        uint32_t formatVersion;
+        uint32_t compilerVersion;
+        uint32_t opCount;
+        uint64_t sourceSize;
+        uint64_t sourceHash;
+        uint64_t fileSize;  ///< A shorter file was cut off
+        uint64_t imageHash; ///< hashImage() of the file
+        uint64_t constantsOffset;
+        uint64_t functionsOffset;
+        uint64_t callSitesOffset;
+        uint64_t codeOffset;
+        uint64_t bytesOffset;
+        uint32_t constantCount;
+        uint32_t functionCount;
+        uint32_t callSiteCount;
+        uint32_t codeCount;
+        uint64_t byteCount;
+        ImageChunk main;
+        uint32_t allFunctions; ///< Compiled with CompileOptions::keepAllFunctions
+        uint32_t hasState;     ///< A snapshot: the globals section and resumePc are set
+        uint64_t globalsOffset;
+        uint64_t globalCount;
+        uint64_t resumePc;
+        uint64_t importsOffset;
+        uint64_t importCount;
+    };
+
+    /** @brief FNV-1a of a whole image, read with ImageHeader::imageHash as zero. */
+    uint64_t hashImage(const std::string_view image) {
+        ImageHeader header;
+        std::memcpy(&header, image.data(), sizeof(ImageHeader));
+        header.imageHash = 0;
+        return hashBytes(image.substr(sizeof(ImageHeader)),
+                         hashBytes({reinterpret_cast<const char*>(&header), sizeof(ImageHeader)}));
+    }
+
+    /** @brief Fixed-width constant; a string is a range of the byte section. */
+    struct ImageConstant {
+        uint8_t tag;
+        uint8_t padding[3];
+        uint32_t length;  ///< String length
+        uint64_t payload; ///< Int, double bits, bool, or string start
+    };
+
+    /** @brief Path of an import statement, a range of the byte section. */
+    struct ImageImport {
+        uint32_t pathStart;
+        uint32_t pathLength;
+    };
+
+    struct ImageGlobal {
+        ImageConstant value;
+        uint32_t isMutable;
+        uint32_t padding;
+    };
+
+    struct ImageFunction {
+        uint32_t nameStart;
+        uint32_t nameLength;
+        uint32_t paramTypesStart; ///< One TypeAnnotation byte per parameter in the byte section
+        uint32_t paramCount;
+        int32_t arity;
+        uint8_t maxRegs;
+        uint8_t returnType;
+        uint8_t flags; ///< compiled, pure, memoize, specializable, dead (bits 0-4)
+        uint8_t padding;
+        int32_t importedFrom; ///< FunctionObject::importedFrom
+        ImageChunk chunk;
+    };
+
+    struct ImageCallSite {
+        uint16_t funcIdx;
+        uint8_t argCount;
+        uint8_t padding;
+    };
+
+    static_assert(std::is_trivially_copyable_v<ImageHeader> && std::is_trivially_copyable_v<ImageConstant> &&
+                  std::is_trivially_copyable_v<ImageFunction> && std::is_trivially_copyable_v<ImageCallSite> &&
+                  std::is_trivially_copyable_v<ImageGlobal> && std::is_trivially_copyable_v<ImageImport>);
+
+    /** @brief Fixed-width form of a value; a string is appended to the byte section. */
+    ImageConstant encodeValue(const Value& value, std::string& byteSection) {
+        ImageConstant constant{};
+        constant.tag = value.tag;
+        switch (value.tag) {
+            case Value::TAG_NULL: break;
+            case Value::TAG_INT: constant.payload = static_cast<uint32_t>(value.asInt); break;
+            case Value::TAG_DOUBLE: constant.payload = std::bit_cast<uint64_t>(value.asDouble); break;
+            case Value::TAG_BOOL: constant.payload = value.asBool; break;
+            case Value::TAG_STRING:
+                constant.length = static_cast<uint32_t>(value.str().size());
+                constant.payload = byteSection.size();
+                byteSection.append(value.str());
+                break;
+        }
+        return constant;
+    }
+
+    /** @brief Elements [start, start + count) of a section; throws if they are not all inside it. */
+    template<typename T>
+    std::span<const T> rangeOf(const std::span<const T> section, const uint64_t start, const uint64_t count) {
+        if (start > section.size() || count > section.size() - start) throw std::runtime_error("Damaged bytecode image");
+        return section.subspan(start, count);
+    }
+
+    /** @brief A section of the file viewed in place; throws if it is misaligned or runs past the end. */
+    template<typename T>
+    std::span<const T> sectionOf(const std::string_view file, const uint64_t offset, const uint64_t count) {
+        const auto address = reinterpret_cast<uintptr_t>(file.data()) + offset;
+        if (address % alignof(T) != 0 || offset > file.size() || count > (file.size() - offset) / sizeof(T)) {
+            throw std::runtime_error("Damaged bytecode image");
+        }
+        return {reinterpret_cast<const T*>(file.data() + offset), count};
+    }
+
+    /**
+     * @brief Constants and call sites in range, so a damaged file cannot send the VM out of bounds.
+     * Only reads the mapped code, so its pages stay shared.
+     */
+    bool operandsValid(const Chunk& chunk) {
+        for (const uint32_t instr : chunk.instructions()) {
+            switch (DECODE_OP(instr)) {
+                case OpCode::OP_LOADK:
+                    if (DECODE_Bx(instr) >= chunk.constants->size()) return false;
+                    break;
+                case OpCode::OP_CALL:
+                    if (DECODE_Bx(instr) >= chunk.callSites.size()) return false;
+                    break;
+                default:
+                    if (static_cast<uint8_t>(DECODE_OP(instr)) >= static_cast<uint8_t>(OpCode::OP_COUNT)) return false;
+                    break;
+            }
+        }
+        return true;
+    }
+
+    std::string cachePathFor(const std::string& scriptPath) {
+        namespace fs = std::filesystem;
+        fs::path script(scriptPath);
+        if (const char* dir = std::getenv("IRIS_CACHE_DIR"); dir && *dir) {
+            // One directory for all scripts: the absolute path tells same-named scripts apart
+            std::error_code error;
+            const fs::path absolute = fs::absolute(script, error);
+            const uint64_t pathHash = hashBytes(error ? scriptPath : absolute.string());
+            char suffix[20];
+            std::snprintf(suffix, sizeof(suffix), "-%016llx", static_cast<unsigned long long>(pathHash));
+            return (fs::path(dir) / (script.stem().string() + suffix + ".irisc")).string();
+        }
+        return script.replace_extension(".irisc").string();
+    }
+}
+
+BytecodeCache::BytecodeCache(const std::string& scriptPath, const std::string_view source, const bool allFunctions)
+    : path(cachePathFor(scriptPath)), sourceSize(source.size()), sourceHash(hashBytes(source)),
+      allFunctions(allFunctions) {}
+
+BytecodeCache BytecodeCache::snapshotOf(const std::string& scriptPath, const std::string_view source) {
+    BytecodeCache file(scriptPath, source);
+    file.path = std::filesystem::path(scriptPath).replace_extension(".irisnap").string();
+    return file;
+}
+
+std::optional<BytecodeCache::Program> BytecodeCache::load() const {
+    if (std::error_code error; !std::filesystem::is_regular_file(path, error)) return std::nullopt;
+    try {
+        std::shared_ptr<const SourceFile> file = std::make_shared<SourceFile>(path);
+        const std::string_view bytes = file->text();
+
+        const ImageHeader& header = sectionOf<ImageHeader>(bytes, 0, 1)[0];
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.formatVersion != FORMAT_VERSION ||
+            header.compilerVersion != Compiler::VERSION || header.opCount != static_cast<uint32_t>(OpCode::OP_COUNT) ||
+            header.fileSize != bytes.size()) return std::nullopt;
+        if (header.sourceSize != sourceSize || header.sourceHash != sourceHash) return std::nullopt;
+        if (allFunctions && !header.allFunctions) return std::nullopt;
+        // Operands are not all range-checked, so any damage has to be caught here
+        if (header.imageHash != hashImage(bytes)) return std::nullopt;
+
+        const auto constantTable = sectionOf<ImageConstant>(bytes, header.constantsOffset, header.constantCount);
+        const auto functionTable = sectionOf<ImageFunction>(bytes, header.functionsOffset, header.functionCount);
+        const auto callSites = sectionOf<ImageCallSite>(bytes, header.callSitesOffset, header.callSiteCount);
+        const auto code = sectionOf<uint32_t>(bytes, header.codeOffset, header.codeCount);
+        const auto byteSection = sectionOf<char>(bytes, header.bytesOffset, header.byteCount);
+        auto text = [&](const uint64_t start, const uint64_t length) {
+            const auto range = rangeOf(byteSection, start, length);
+            return std::string_view(range.data(), range.size());
+        };
+        auto decodeValue = [&](const ImageConstant& constant) {
+            switch (constant.tag) {
+                case Value::TAG_NULL: return Value();
+                case Value::TAG_INT: return Value(static_cast<int32_t>(constant.payload));
+                case Value::TAG_DOUBLE: return Value(std::bit_cast<double>(constant.payload));
+                case Value::TAG_BOOL: return Value(constant.payload != 0);
+                case Value::TAG_STRING: return Value(std::string(text(constant.payload, constant.length)));
+                default: throw std::runtime_error("Damaged bytecode image");
+            }
+        };
+
+        Program program;
+        program.mapping = file;
+        auto constants = std::make_shared<ConstantPool>();
+        for (size_t i = 0; i < constantTable.size(); i++) {
+            // The pool was written in index order without duplicates, so indices come out the same
+            if (constants->add(decodeValue(constantTable[i])) != i) return std::nullopt;
+        }
+
+        auto loadChunk = [&](const ImageChunk& image, Chunk& chunk) {
+            chunk.image = rangeOf(code, image.codeStart, image.codeCount);
+            chunk.constants = constants;
+            const auto sites = rangeOf(callSites, image.callSiteStart, image.callSiteCount);
+            chunk.callSites.reserve(sites.size());
+            for (const ImageCallSite& site : sites) {
+                if (site.funcIdx >= functionTable.size()) throw std::runtime_error("Damaged bytecode image");
+                chunk.callSites.emplace_back(site.funcIdx, site.argCount);
+            }
+            if (!operandsValid(chunk)) throw std::runtime_error("Damaged bytecode image");
+        };
+        for (size_t i = 0; i < functionTable.size(); i++) {
+            const ImageFunction& image = functionTable[i];
+            FunctionObject& func = program.functions.emplace_back();
+            func.name = text(image.nameStart, image.nameLength);
+            func.arity = image.arity;
+            func.maxRegs = image.maxRegs;
+            func.returnType = static_cast<TypeAnnotation>(image.returnType);
+            for (const char type : text(image.paramTypesStart, image.paramCount)) {
+                func.paramTypes.push_back(static_cast<TypeAnnotation>(type));
+            }
+            func.compiled = image.flags & 1;
+            func.pure = image.flags & 2;
+            func.memoize = image.flags & 4;
+            func.specializable = image.flags & 8;
+            func.dead = image.flags & 16;
+            func.index = static_cast<uint16_t>(i);
+            func.importedFrom = image.importedFrom;
+            loadChunk(image.chunk, func.chunk);
+        }
+        loadChunk(header.main, program.main);
+        for (const ImageImport& import : sectionOf<ImageImport>(bytes, header.importsOffset, header.importCount)) {
+            program.imports.emplace_back(text(import.pathStart, import.pathLength));
+        }
+        for (const FunctionObject& func : program.functions) {
+            if (func.importedFrom >= static_cast<int>(program.imports.size())) return std::nullopt;
+        }
+
+        if (header.hasState) {
+            // Resumes right after the snapshot statement
+            const auto main = program.main.instructions();
+            if (header.resumePc == 0 || header.resumePc >= main.size() ||
+                DECODE_OP(main[header.resumePc - 1]) != OpCode::OP_SNAPSHOT) return std::nullopt;
+            State& state = program.state.emplace();
+            state.resumePc = header.resumePc;
+            for (const ImageGlobal& global : sectionOf<ImageGlobal>(bytes, header.globalsOffset, header.globalCount)) {
+                state.globals.push_back({decodeValue(global.value), global.isMutable != 0});
+            }
+        }
+        return program;
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+}
+
+bool BytecodeCache::store(const Chunk& main, const std::deque<FunctionObject>& functions,
+                          const std::vector<std::string>& imports, const State* state) const {
+    std::vector<ImageConstant> constantTable;
+    std::vector<ImageFunction> functionTable;
+    std::vector<ImageCallSite> callSites;
+    std::vector<uint32_t> code;
+    std::string byteSection;
+
+    auto addBytes = [&](const std::string_view text) {
+        const auto start = static_cast<uint32_t>(byteSection.size());
+        byteSection.append(text);
+        return start;
+    };
+    auto addChunk = [&](const Chunk& chunk) {
+        const std::span<const uint32_t> instructions = chunk.instructions();
+        const ImageChunk image{static_cast<uint32_t>(code.size()), static_cast<uint32_t>(instructions.size()),
+                               static_cast<uint32_t>(callSites.size()), static_cast<uint32_t>(chunk.callSites.size())};
+        code.insert(code.end(), instructions.begin(), instructions.end());
+        for (const CallSite& site : chunk.callSites) callSites.push_back({site.funcIdx, site.argCount, 0});
+        return image;
+    };
+
+    const ConstantPool& constants = *main.constants;
+    for (size_t i = 0; i < constants.size(); i++) constantTable.push_back(encodeValue(constants[i], byteSection));
+
+    std::vector<ImageGlobal> globals;
+    if (state) {
+        for (const Variable& global : state->globals) {
+            globals.push_back({encodeValue(global.value, byteSection), global.isMutable, 0});
+        }
+    }
+
+    for (const FunctionObject& func : functions) {
+        ImageFunction& image = functionTable.emplace_back();
+        image.nameStart = addBytes(func.name);
+        image.nameLength = static_cast<uint32_t>(func.name.size());
+        image.paramTypesStart = static_cast<uint32_t>(byteSection.size());
+        image.paramCount = static_cast<uint32_t>(func.paramTypes.size());
+        for (const TypeAnnotation type : func.paramTypes) byteSection.push_back(static_cast<char>(type));
+        image.arity = func.arity;
+        image.maxRegs = func.maxRegs;
+        image.returnType = static_cast<uint8_t>(func.returnType);
+        image.flags = static_cast<uint8_t>(func.compiled | func.pure << 1 | func.memoize << 2 | func.specializable << 3 | func.dead << 4);
+        image.importedFrom = func.importedFrom;
+        image.chunk = addChunk(func.chunk);
+    }
+
+    ImageHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.formatVersion = FORMAT_VERSION;
+    header.compilerVersion = Compiler::VERSION;
+    header.opCount = static_cast<uint32_t>(OpCode::OP_COUNT);
+    header.sourceSize = sourceSize;
+    header.sourceHash = sourceHash;
+    header.allFunctions = allFunctions;
+    header.main = addChunk(main);
+    std::vector<ImageImport> importTable;
+    for (const std::string& import : imports) {
+        importTable.push_back({addBytes(import), static_cast<uint32_t>(import.size())});
+    }
+    header.importCount = importTable.size();
+    header.constantCount = static_cast<uint32_t>(constantTable.size());
+    header.functionCount = static_cast<uint32_t>(functionTable.size());
+    header.callSiteCount = static_cast<uint32_t>(callSites.size());
+    header.codeCount = static_cast<uint32_t>(code.size());
+    header.byteCount = byteSection.size();
+    header.hasState = state != nullptr;
+    header.globalCount = globals.size();
+    header.resumePc = state ? state->resumePc : 0;
+
+    std::string image(sizeof(ImageHeader), '\0');
+    auto appendSection = [&](const void* data, const size_t size) {
+        image.resize((image.size() + SECTION_ALIGN - 1) / SECTION_ALIGN * SECTION_ALIGN, '\0');
+        const uint64_t offset = image.size();
+        image.append(static_cast<const char*>(data), size);
+        return offset;
+    };
+    header.constantsOffset = appendSection(constantTable.data(), constantTable.size() * sizeof(ImageConstant));
+    header.functionsOffset = appendSection(functionTable.data(), functionTable.size() * sizeof(ImageFunction));
+    header.callSitesOffset = appendSection(callSites.data(), callSites.size() * sizeof(ImageCallSite));
+    header.codeOffset = appendSection(code.data(), code.size() * sizeof(uint32_t));
+    header.bytesOffset = appendSection(byteSection.data(), byteSection.size());
+    header.globalsOffset = appendSection(globals.data(), globals.size() * sizeof(ImageGlobal));
+    header.importsOffset = appendSection(importTable.data(), importTable.size() * sizeof(ImageImport));
+    header.fileSize = image.size();
+    std::memcpy(image.data(), &header, sizeof(ImageHeader));
+    header.imageHash = hashImage(image);
+    std::memcpy(image.data(), &header, sizeof(ImageHeader));
+
+    // Written under a unique name and renamed over the old file in one step
+    const auto stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const std::string temp = path + "." + std::to_string(stamp) + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) return false;
+        out.write(image.data(), static_cast<std::streamsize>(image.size()));
+        if (!out.flush()) {
+            out.close();
+            std::error_code error;
+            std::filesystem::remove(temp, error);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    if (!error) return true;
+    std::filesystem::remove(temp, error);
+    return false;
+}
@@ -0,0 +1,83 @@
+#ifndef BYTECODECACHE_H
+#define BYTECODECACHE_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Chunk.h"
+#include "Compiler.h"
+#include "../core/Variable.h"
+#include "../parser/SourceFile.h"
+
+/**
+ * @brief Compiled form of a script kept on disk (script.irisc), so an unchanged script
+ * skips lexing, parsing and compiling.
+ * The file is written next to the script, or into $IRIS_CACHE_DIR if that is set. It is
+ * reused only if the source text hashes the same, it was written by the same compiler
+ * version and its own checksum still matches. Only eagerly compiled programs are cached: lazy and tiered execution compile
+ * from the AST at run time.
+ *
+ * The file is an image the VM runs in place: fixed-width tables that refer to each other
+ * by offset, and one section holding the code of every chunk. Loading maps the file and
+ * points each Chunk::image into it, so the code is never copied or parsed and processes
+ * running the same script share its pages. Only the constants (strings become Values),
+ * the function table and the call sites (their inline caches are written at run time)
+ * are built in memory.
+ *
+ * A snapshot file (script.irisnap, written by --snapshot) is the same image plus the
+ * globals at the script's snapshot statement and the point to resume from.
+ */
+class BytecodeCache {
+public:
+    /** @brief Bumped whenever the file layout changes. */
+    static constexpr uint32_t FORMAT_VERSION = 6;
+
+    /** @brief Top-level state captured at a snapshot statement. */
+    struct State {
+        std::vector<Variable> globals;
+        size_t resumePc; ///< Main-chunk pc after the snapshot statement
+    };
+
+    /** @brief Everything the VM needs to run a program without its AST. */
+    struct Program {
+        std::shared_ptr<const SourceFile> mapping; ///< The image the chunks' code points into
+        Chunk main;
+        std::deque<FunctionObject> functions;
+        std::vector<std::string> imports; ///< Paths of the import statements, as written
+        std::optional<State> state;       ///< Set in snapshot files
+    };
+
+    /**
+     * @param allFunctions The program is compiled with CompileOptions::keepAllFunctions. Such a
+     * file also serves runs without it; the other way round it is recompiled.
+     */
+    BytecodeCache(const std::string& scriptPath, std::string_view source, bool allFunctions = false);
+
+    /** @brief The snapshot file of a script: script.irisnap next to it. */
+    static BytecodeCache snapshotOf(const std::string& scriptPath, std::string_view source);
+
+    /** @return The cached program, or nullopt if there is none, it is stale or it is damaged. */
+    [[nodiscard]] std::optional<Program> load() const;
+
+    /**
+     * @brief Writes the program, and the snapshot state if given, for later runs.
+     * The file is replaced atomically, so concurrent runs never read a partial one.
+     * @return False if the file could not be written; the cache ignores that.
+     */
+    bool store(const Chunk& main, const std::deque<FunctionObject>& functions,
+               const std::vector<std::string>& imports = {}, const State* state = nullptr) const;
+
+    [[nodiscard]] const std::string& getPath() const { return path; }
+
+private:
+    std::string path;
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    bool allFunctions;
+};
+
+#endif //BYTECODECACHE_H
@@ -1,21 +1,75 @@
 #ifndef CHUNK_H
 #define CHUNK_H
 
+#include <memory>
+#include <span>
+#include <utility>
 #include <vector>
 #include <cstdint>
 #include <stdexcept>
-#include <unordered_map>
 #include "../core/Value.h"
+#include "ConstantPool.h"
 #include "OpCode.h"
 
+struct FunctionObject;
+class ASTNode;
+
+/**
+ * @brief Static target of an OP_CALL plus the call site's inline cache.
+ * The cache fields are filled in by the VM at run time.
+ */
+struct CallSite {
+    uint16_t funcIdx;
+    uint8_t argCount;
+
+    uint64_t lastSignature = 0;              ///< Argument types of the previous call
+    uint32_t hits = 0;                       ///< Consecutive calls with lastSignature
+    uint64_t cachedSignature = 0;
+    FunctionObject* cachedTarget = nullptr;  ///< Callee to run for cachedSignature
+    const FunctionObject* cachedFor = nullptr; ///< Body cachedTarget was specialized from
+
+    CallSite(uint16_t funcIdx, uint8_t argCount) : funcIdx(funcIdx), argCount(argCount) {}
+};
+
 /**
- * @brief A block of bytecode instructions and constants.
- * Represents a compiled function or the main program body.
+ * @brief Position of a while/for loop header, recorded for on-stack replacement.
+ */
+struct LoopHeader {
+    const ASTNode* loop; ///< Source loop, identifies the same loop across tiers
+    size_t pc;           ///< Target of the loop's back-edge
+    uint8_t liveRegs;    ///< Registers holding locals at the header (R[0]..R[liveRegs-1])
+};
+
+/**
+ * @brief A block of bytecode instructions.
+ * Represents a compiled function or the main program body. LOADK operands index
+ * the program-wide constant pool, which all chunks of one compilation share.
  */
 struct Chunk {
     std::vector<uint32_t> code;
-    std::vector<Value> constants;
-    std::unordered_map<std::string, uint16_t> stringIntern;
+    std::span<const uint32_t> image; ///< Instructions inside a mapped bytecode image (code is empty then)
+    std::shared_ptr<ConstantPool> constants;
+    std::vector<CallSite> callSites; ///< Indexed by the Bx operand of OP_CALL
+    std::vector<LoopHeader> loopHeaders;
+
+    /** @brief The instructions to run: the mapped image if the chunk was loaded from one, else code. */
+    [[nodiscard]] std::span<const uint32_t> instructions() const {
+        return image.empty() ? std::span<const uint32_t>(code) : image;
+    }
+
+    /**
+     * @brief A copy for another VM running the same program: instructions and constants are
+     * shared, call sites start with empty inline caches. Loop headers (tier-up only) are left out.
+     * This chunk must outlive the copy.
+     */
+    [[nodiscard]] Chunk share() const {
+        Chunk copy;
+        copy.image = instructions();
+        copy.constants = constants;
+        copy.callSites.reserve(callSites.size());
+        for (const CallSite& site : callSites) copy.callSites.emplace_back(site.funcIdx, site.argCount);
+        return copy;
+    }
 
     /** @brief Appends a 32-bit instruction to the chunk. */
     void emit(uint32_t instr) {
@@ -23,22 +77,33 @@ struct Chunk {
     }
 
     /**
-     * @brief Adds a constant to the pool, reusing strings if possible.
+     * @brief Adds a constant to the shared pool, reusing an equal one if present.
      * @return The index of the constant in the pool.
      */
     uint16_t addConstant(const Value& value) {
-        if (value.isString()) {
-            auto it = stringIntern.find(value.str());
-            if (it != stringIntern.end()) {
-                return it->second;
-            }
-            constants.push_back(value);
-            const auto idx = static_cast<uint16_t>(constants.size() - 1);
-            stringIntern[value.str()] = idx;
-            return idx;
+        return constants->add(value);
+    }
+
+    /**
+     * @brief Switches the chunk to another pool, adding the constants it loads and rewriting
+     * its LOADK operands. Used for code built by a forked compiler, which has a pool of its own.
+     */
+    void moveConstantsTo(const std::shared_ptr<ConstantPool>& pool) {
+        const std::shared_ptr<ConstantPool> own = std::exchange(constants, pool);
+        for (uint32_t& instr : code) {
+            if (DECODE_OP(instr) != OpCode::OP_LOADK) continue;
+            instr = encodeABx(OpCode::OP_LOADK, DECODE_A(instr), addConstant((*own)[DECODE_Bx(instr)]));
         }
-        constants.push_back(value);
-        return static_cast<uint16_t>(constants.size() - 1);
+    }
+
+    /**
+     * @brief Registers a call site for an OP_CALL instruction.
+     * @return The index to encode in the instruction's Bx operand.
+     */
+    uint16_t addCallSite(uint16_t funcIdx, uint8_t argCount) {
+        if (callSites.size() > UINT16_MAX) throw std::runtime_error("Too many call sites in one function");
+        callSites.emplace_back(funcIdx, argCount);
+        return static_cast<uint16_t>(callSites.size() - 1);
     }
 
     /**
@@ -55,7 +120,9 @@ struct Chunk {
      * Calculates the offset from the jump instruction to the current end of code.
      */
     void patchJump(size_t instrIdx) {
-        int16_t offset = static_cast<int16_t>(code.size() - instrIdx - 1);
+        const size_t distance = code.size() - instrIdx - 1;
+        if (distance > INT16_MAX) throw std::runtime_error("Jump too long: block exceeds 32767 instructions");
+        int16_t offset = static_cast<int16_t>(distance);
         uint32_t old = code[instrIdx];
         OpCode op = DECODE_OP(old);
         uint8_t a = DECODE_A(old);
@@ -67,7 +134,9 @@ struct Chunk {
      * Calculates the negative offset to jump back to loopStart.
      */
     void emitLoop(size_t loopStart) {
-        int16_t offset = -static_cast<int16_t>(code.size() - loopStart + 1);
+        const size_t distance = code.size() - loopStart + 1;
+        if (distance > INT16_MAX) throw std::runtime_error("Jump too long: loop exceeds 32767 instructions");
+        int16_t offset = -static_cast<int16_t>(distance);
         emit(encodesBx(OpCode::OP_LOOP, offset));
     }
 };
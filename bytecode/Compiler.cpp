@@ -1,13 +1,249 @@
 #include "Compiler.h"
+#include "ConstFold.h"
+#include "DeadCode.h"
+#include "RegAlloc.h"
+#include "Specializer.h"
+#include "../core/Parallel.h"
+#include <algorithm>
+#include <bit>
+#include <optional>
 #include <ranges>
 #include <stdexcept>
+#include <utility>
+
+/** @brief True if any statement (at any depth) declares a function. */
+static bool containsFunctionDecl(NodeList stmts) {
+    for (const auto& stmt : stmts) {
+        switch (stmt->getType()) {
+            case StmtType::FunctionDecl: return true;
+            case StmtType::Repeat: if (containsFunctionDecl(static_cast<RepeatNode*>(stmt)->body)) return true; break;
+            case StmtType::While: if (containsFunctionDecl(static_cast<WhileNode*>(stmt)->body)) return true; break;
+            case StmtType::For: if (containsFunctionDecl(static_cast<ForNode*>(stmt)->body)) return true; break;
+            case StmtType::If: {
+                auto* ifNode = static_cast<IfNode*>(stmt);
+                if (containsFunctionDecl(ifNode->thenBlock) || containsFunctionDecl(ifNode->elseBlock)) return true;
+                break;
+            }
+            default: break;
+        }
+    }
+    return false;
+}
+
+/** @brief Adds the names the statements assign to. Nested function bodies have locals of their own. */
+static void collectAssigned(NodeList stmts, std::unordered_set<Symbol>& names) {
+    for (ASTNode* stmt : stmts) {
+        switch (stmt->getType()) {
+            case StmtType::Assignment: names.insert(static_cast<AssignmentNode*>(stmt)->nameOfVariable); break;
+            case StmtType::Repeat: collectAssigned(static_cast<RepeatNode*>(stmt)->body, names); break;
+            case StmtType::While: collectAssigned(static_cast<WhileNode*>(stmt)->body, names); break;
+            case StmtType::For: {
+                auto* loop = static_cast<ForNode*>(stmt);
+                if (loop->init) collectAssigned(NodeList(&loop->init, 1), names);
+                collectAssigned(loop->body, names);
+                if (loop->increment) collectAssigned(NodeList(&loop->increment, 1), names);
+                break;
+            }
+            case StmtType::If:
+                collectAssigned(static_cast<IfNode*>(stmt)->thenBlock, names);
+                collectAssigned(static_cast<IfNode*>(stmt)->elseBlock, names);
+                break;
+            case StmtType::MouseBlock: collectAssigned(static_cast<MouseBlockNode*>(stmt)->actions, names); break;
+            case StmtType::KeyboardBlock: collectAssigned(static_cast<KeyboardBlockNode*>(stmt)->actions, names); break;
+            default: break;
+        }
+    }
+}
+
+/** @brief repeat() with a constant count up to this is unrolled completely. */
+static constexpr int UNROLL_FULL_MAX = 16;
+/** @brief Maximum estimated instructions an unrolled repeat body may expand to. */
+static constexpr int UNROLL_BUDGET = 128;
+/** @brief Maximum number of body copies per iteration of a partially unrolled loop. */
+static constexpr int UNROLL_FACTOR_MAX = 4;
+
+/** @brief Layout of an unrolled repeat: blocks loop iterations of copies bodies, then remainder more. */
+struct RepeatUnroll {
+    int blocks;     ///< Loop iterations; 0 when unrolled completely
+    int copies;     ///< Body copies per iteration, or all of them when unrolled completely
+    int remainder;  ///< Body copies after the loop
+};
+
+/** @brief How a repeat of count > 0 iterations is unrolled, or nullopt to keep one body in the loop. */
+static std::optional<RepeatUnroll> planUnroll(const int count, const int bodyCost) {
+    if (count <= UNROLL_FULL_MAX && count * bodyCost <= UNROLL_BUDGET) return RepeatUnroll{0, count, 0};
+    const int factor = std::min(UNROLL_FACTOR_MAX, UNROLL_BUDGET / bodyCost);
+    if (factor >= 2) return RepeatUnroll{count / factor, factor, count % factor};
+    return std::nullopt;
+}
+
+/** @brief Rough instruction count of an expression. */
+static int estimateCost(ExpressionNode* expr) {
+    switch (expr->getType()) {
+        case ExprType::BinaryOp: {
+            auto* bin = static_cast<BinaryOperationNode*>(expr);
+            return 1 + estimateCost(bin->leftNode) + estimateCost(bin->rightNode);
+        }
+        case ExprType::UnaryOp:
+            return 1 + estimateCost(static_cast<UnaryOperationNode*>(expr)->operand);
+        case ExprType::FunctionCall: {
+            int cost = 2;
+            for (auto& arg : static_cast<FunctionCallNode*>(expr)->args) cost += estimateCost(arg);
+            return cost;
+        }
+        default:
+            return 1;
+    }
+}
+
+static int estimateCost(NodeList stmts);
+
+/** @brief Rough instruction count of a statement, used for the unrolling budget. */
+static int estimateCost(ASTNode* stmt) {
+    switch (stmt->getType()) {
+        case StmtType::Print: return 1 + estimateCost(static_cast<PrintNode*>(stmt)->msg);
+        case StmtType::Wait: return 1 + estimateCost(static_cast<WaitNode*>(stmt)->duration);
+        case StmtType::VarDecl: return 2 + estimateCost(static_cast<VarDeclNode*>(stmt)->expression);
+        case StmtType::Assignment: return 2 + estimateCost(static_cast<AssignmentNode*>(stmt)->expression);
+        case StmtType::Return: {
+            auto* ret = static_cast<ReturnNode*>(stmt);
+            return 1 + (ret->expression ? estimateCost(ret->expression) : 1);
+        }
+        case StmtType::If: {
+            auto* ifNode = static_cast<IfNode*>(stmt);
+            return 2 + estimateCost(ifNode->condition) + estimateCost(ifNode->thenBlock) + estimateCost(ifNode->elseBlock);
+        }
+        case StmtType::While: {
+            auto* loop = static_cast<WhileNode*>(stmt);
+            return 2 + estimateCost(loop->condition) + estimateCost(loop->body);
+        }
+        case StmtType::For: {
+            auto* loop = static_cast<ForNode*>(stmt);
+            int cost = 2 + estimateCost(loop->condition) + estimateCost(loop->body);
+            if (loop->init) cost += estimateCost(loop->init);
+            if (loop->increment) cost += estimateCost(loop->increment);
+            return cost;
+        }
+        case StmtType::Repeat: {
+            auto* loop = static_cast<RepeatNode*>(stmt);
+            const int bodyCost = std::max(1, estimateCost(loop->body));
+            // Counts the copies compileRepeat() makes, or nested repeats would each unroll to the full budget
+            int count;
+            if (foldIntConstant(loop->count, count) && !containsFunctionDecl(loop->body)) {
+                if (count <= 0) return 0;
+                if (const auto unroll = planUnroll(count, bodyCost)) {
+                    return 5 + (unroll->copies + unroll->remainder) * bodyCost;
+                }
+            }
+            return 5 + bodyCost;
+        }
+        default:
+            return 1;
+    }
+}
+
+static int estimateCost(NodeList stmts) {
+    int cost = 0;
+    for (auto& stmt : stmts) cost += estimateCost(stmt);
+    return cost;
+}
+
+static bool isNumericType(TypeAnnotation t) {
+    return t == TypeAnnotation::Int || t == TypeAnnotation::Double;
+}
+
+static bool fitsImm8(int v) {
+    return v >= INT8_MIN && v <= INT8_MAX;
+}
+
+static bool isPowerOfTwo(int v) {
+    return v > 0 && std::has_single_bit(static_cast<unsigned>(v));
+}
+
+/** @brief True if the code touches no globals, does no I/O and only calls pure functions or itself. */
+static bool isPureChunk(const Chunk& code, const uint16_t self, const std::deque<FunctionObject>& functions) {
+    for (const uint32_t instr : code.code) {
+        switch (DECODE_OP(instr)) {
+            case OpCode::OP_GGLOB:
+            case OpCode::OP_SGLOB:
+            case OpCode::OP_DGLOB:
+            case OpCode::OP_LOG:
+            case OpCode::OP_WAIT:
+                return false;
+            case OpCode::OP_CALL: {
+                const uint16_t callee = code.callSites[DECODE_Bx(instr)].funcIdx;
+                if (callee != self && !functions[callee].pure) return false;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    return true;
+}
+
+Compiler::Purity Compiler::provePure(const uint16_t funcIdx, std::unordered_set<uint16_t>& visited) {
+    // Already on the path or proven: a cycle of calls is pure unless one of its members is not
+    if (!visited.insert(funcIdx).second) return Purity::Pure;
+    ensureCompiled(funcIdx);
+    const FunctionObject& func = functions[funcIdx];
+    if (func.importedFrom >= 0) return func.pure ? Purity::Pure : Purity::Impure;
+    if (!func.compiled) return Purity::Unknown;
+    for (const uint32_t instr : func.chunk.code) {
+        switch (DECODE_OP(instr)) {
+            case OpCode::OP_GGLOB:
+            case OpCode::OP_SGLOB:
+            case OpCode::OP_DGLOB:
+            case OpCode::OP_LOG:
+            case OpCode::OP_WAIT:
+                return Purity::Impure;
+            case OpCode::OP_CALL:
+                if (const Purity callee = provePure(func.chunk.callSites[DECODE_Bx(instr)].funcIdx, visited);
+                    callee != Purity::Pure) return callee;
+                break;
+            default:
+                break;
+        }
+    }
+    return Purity::Pure;
+}
 
 Chunk Compiler::compile(ProgramNode* program) {
+    symbols = program->symbols;
+    liveFunctions = findLiveFunctions(program);
+    if (options.parallelFunctions && !options.lazyFunctions) precompileFunctions(program->statements);
     compileProgram(program);
     chunk.emit(encodeABC(OpCode::OP_HALT, 0, 0, 0));
+
+    // Unreachable functions were compiled for their errors only; their slots keep later indices stable
+    for (FunctionObject& func : functions) {
+        if (!func.decl || isLive(func.decl->name)) continue;
+        func.chunk = Chunk{};
+        func.chunk.constants = constants;
+        func.maxRegs = 0;
+        func.compiled = true;
+        func.pure = false;
+        func.specializable = false;
+        func.tier = TierState::Final;
+        func.dead = true;
+    }
     return std::move(chunk);
 }
 
+Chunk Compiler::compileBatch(ProgramNode* batch) {
+    symbols = batch->symbols;
+    streaming = true;
+    // A pool per batch: the literals of a long generated script would overflow a shared one.
+    // Function bodies still use the program-wide pool (compileBodyChunk).
+    chunk.constants = std::make_shared<ConstantPool>();
+    compileProgram(batch);
+    chunk.emit(encodeABC(OpCode::OP_HALT, 0, 0, 0));
+    Chunk main = std::move(chunk);
+    chunk = Chunk();
+    chunk.constants = constants;
+    return main;
+}
+
 void Compiler::compileNode(ASTNode* node) {
     switch (node->getType()) {
         case StmtType::Program: compileProgram(static_cast<ProgramNode*>(node)); return;
@@ -23,6 +259,8 @@ void Compiler::compileNode(ASTNode* node) {
         case StmtType::Continue: compileContinue(); return;
         case StmtType::FunctionDecl: compileFunctionDecl(static_cast<FunctionDeclNode*>(node)); return;
         case StmtType::Return: compileReturn(static_cast<ReturnNode*>(node)); return;
+        case StmtType::Snapshot: compileSnapshot(); return;
+        case StmtType::Import: compileImport(); return;
         default:
             throw std::runtime_error("Compiler: unknown AST node type");
     }
@@ -45,21 +283,68 @@ uint8_t Compiler::compileExpression(ExpressionNode* expr, uint8_t dst) {
 }
 
 void Compiler::compileProgram(ProgramNode* node) {
-    for (auto& stmt : node->statements) {
-        compileNode(stmt.get());
+    assignedNames.clear();
+    collectAssigned(node->statements, assignedNames);
+    compileBlock(node->statements);
+}
+
+bool Compiler::compileBlock(NodeList stmts) {
+    for (size_t i = 0; i < stmts.size(); i++) {
+        compileNode(stmts[i]);
+        // Anything after an unconditional exit is unreachable
+        if (alwaysExits(stmts[i])) {
+            compileDiscarded(stmts.subspan(i + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+void Compiler::compileDiscarded(NodeList stmts, const bool loopBody) {
+    if (stmts.empty()) return;
+    const size_t codeSize = chunk.code.size();
+    const size_t callSiteCount = chunk.callSites.size();
+    const size_t loopHeaderCount = chunk.loopHeaders.size();
+    const std::vector<LoopContext> savedLoops = loopStack;
+    const uint8_t savedMaxReg = maxReg;
+
+    if (loopBody) {
+        loopStack.push_back({LoopContext::PENDING, {}, {}, scopeDepth});
+        beginScope();
     }
+    for (ASTNode* stmt : stmts) compileNode(stmt);
+    if (loopBody) endScope();
+
+    chunk.code.resize(codeSize);
+    chunk.callSites.erase(chunk.callSites.begin() + static_cast<std::ptrdiff_t>(callSiteCount), chunk.callSites.end());
+    chunk.loopHeaders.resize(loopHeaderCount);
+    loopStack = savedLoops;
+    // Locals declared here stay in scope (and in their registers) until the enclosing block ends
+    maxReg = std::max(savedMaxReg, nextReg);
+}
+
+void Compiler::compileSnapshot() {
+    // Only globals are carried over, so nothing else may be live where the program resumes
+    if (!isGlobalScope()) throw std::runtime_error("snapshot is only allowed at the top level");
+    chunk.emit(encodeABC(OpCode::OP_SNAPSHOT, 0, 0, 0));
+}
+
+void Compiler::compileImport() {
+    if (!isGlobalScope()) throw std::runtime_error("import is only allowed at the top level");
+    // Modules are loaded, and their top-level code run, before the importing program starts
+    if (!options.resolvesImports) throw std::runtime_error("import needs ahead-of-time compilation (not --lazy, --tiered, --stream or --snapshot)");
 }
 
 void Compiler::compileLog(PrintNode* node) {
     uint8_t save = nextReg;
-    uint8_t r = compileExpression(node->msg.get());
+    uint8_t r = compileExpression(node->msg);
     chunk.emit(encodeABC(OpCode::OP_LOG, r, 0, 0));
     freeRegsTo(save);
 }
 
 void Compiler::compileWait(WaitNode* node) {
     uint8_t save = nextReg;
-    uint8_t r = compileExpression(node->duration.get());
+    uint8_t r = compileExpression(node->duration);
     chunk.emit(encodeABC(OpCode::OP_WAIT, r, 0, 0));
     freeRegsTo(save);
 }
@@ -67,16 +352,9 @@ void Compiler::compileWait(WaitNode* node) {
 void Compiler::compileVarDecl(VarDeclNode* node) {
     const TypeAnnotation annot = node->typeAnnotation;
     if (isGlobalScope()) {
-        uint16_t slot;
-        auto it = globalIndex.find(node->nameOfVariable);
-        if (it == globalIndex.end()) {
-            slot = globalCount++;
-            globalIndex[node->nameOfVariable] = slot;
-        } else {
-            slot = it->second;
-        }
+        const uint16_t slot = declareGlobal(node->nameOfVariable);
         uint8_t save = nextReg;
-        uint8_t r = compileExpression(node->expression.get());
+        uint8_t r = compileExpression(node->expression);
         // Runtime type check if annotation is present
         if (annot != TypeAnnotation::None)
             chunk.emit(encodeABC(OpCode::OP_TYPECHECK, r, static_cast<uint8_t>(annot), 0));
@@ -85,10 +363,12 @@ void Compiler::compileVarDecl(VarDeclNode* node) {
     } else {
         addLocal(node->nameOfVariable, node->isMutable, annot);
         int idx = resolveLocal(node->nameOfVariable);
-        compileExpression(node->expression.get(), locals[idx].reg);
+        compileExpression(node->expression, locals[idx].reg);
         // Runtime type check if annotation is present
         if (annot != TypeAnnotation::None)
             chunk.emit(encodeABC(OpCode::OP_TYPECHECK, locals[idx].reg, static_cast<uint8_t>(annot), 0));
+        else if (!node->isMutable || !assignedNames.contains(node->nameOfVariable))
+            locals[idx].knownType = inferType(node->expression);
     }
 }
 
@@ -96,54 +376,85 @@ void Compiler::compileAssignment(AssignmentNode* node) {
     int arg = resolveLocal(node->nameOfVariable);
     if (arg != -1) {
         if (!locals[arg].isMutable) throw std::runtime_error("Variable is immutable.");
-        compileExpression(node->expression.get(), locals[arg].reg);
+        compileExpression(node->expression, locals[arg].reg);
     } else {
-        auto it = globalIndex.find(node->nameOfVariable);
-        if (it == globalIndex.end()) throw std::runtime_error("Undefined variable.");
+        const auto slot = findGlobal(node->nameOfVariable);
+        if (!slot) throw std::runtime_error("Undefined variable.");
         uint8_t save = nextReg;
-        uint8_t r = compileExpression(node->expression.get());
-        chunk.emit(encodeABx(OpCode::OP_SGLOB, r, it->second));
+        uint8_t r = compileExpression(node->expression);
+        chunk.emit(encodeABx(OpCode::OP_SGLOB, r, *slot));
         freeRegsTo(save);
     }
 }
 
 void Compiler::compileIf(IfNode* node) {
+    // Constant condition: only the taken branch is emitted
+    if (bool constCond; foldBoolConstant(node->condition, constCond)) {
+        beginScope();
+        if (constCond) compileBlock(node->thenBlock);
+        else compileDiscarded(node->thenBlock);
+        endScope();
+
+        beginScope();
+        if (constCond) compileDiscarded(node->elseBlock);
+        else compileBlock(node->elseBlock);
+        endScope();
+        return;
+    }
+
     uint8_t save = nextReg;
-    uint8_t cond = compileExpression(node->condition.get());
+    uint8_t cond = compileExpression(node->condition);
 
     size_t thenJump = chunk.emitJump(OpCode::OP_JMPF, cond);
     freeRegsTo(save);
 
     beginScope();
-    for (auto& stmt : node->thenBlock) compileNode(stmt.get());
+    const bool thenExits = compileBlock(node->thenBlock);
     endScope();
 
-    size_t elseJump = chunk.emitJump(OpCode::OP_JMP);
+    if (node->elseBlock.empty()) {
+        chunk.patchJump(thenJump);
+        return;
+    }
+
+    // A then-branch that always exits never reaches the jump over the else-branch
+    size_t elseJump = thenExits ? 0 : chunk.emitJump(OpCode::OP_JMP);
     chunk.patchJump(thenJump);
 
     beginScope();
-    for (auto& stmt : node->elseBlock) compileNode(stmt.get());
+    compileBlock(node->elseBlock);
     endScope();
 
-    chunk.patchJump(elseJump);
+    if (!thenExits) chunk.patchJump(elseJump);
 }
 
 void Compiler::compileWhile(WhileNode* node) {
-    const size_t loopStart = chunk.code.size();
-    loopStack.push_back({loopStart, {}, scopeDepth});
+    bool constCond = false;
+    const bool isConst = foldBoolConstant(node->condition, constCond);
+    if (isConst && !constCond) {
+        compileDiscarded(node->body, true);
+        return;
+    }
 
-    uint8_t save = nextReg;
-    uint8_t cond = compileExpression(node->condition.get());
+    const size_t loopStart = chunk.code.size();
+    chunk.loopHeaders.push_back({node, loopStart, nextReg});
+    loopStack.push_back({loopStart, {}, {}, scopeDepth});
 
-    size_t exitJump = chunk.emitJump(OpCode::OP_JMPF, cond);
-    freeRegsTo(save);
+    // while(true) has no condition check; only 'break' leaves it
+    size_t exitJump = 0;
+    if (!isConst) {
+        uint8_t save = nextReg;
+        uint8_t cond = compileExpression(node->condition);
+        exitJump = chunk.emitJump(OpCode::OP_JMPF, cond);
+        freeRegsTo(save);
+    }
 
     beginScope();
-    for (auto& stmt : node->body) compileNode(stmt.get());
+    compileBlock(node->body);
     endScope();
 
     chunk.emitLoop(loopStart);
-    chunk.patchJump(exitJump);
+    if (!isConst) chunk.patchJump(exitJump);
 
     for (size_t breakJump : loopStack.back().breakJumps) {
         chunk.patchJump(breakJump);
@@ -153,26 +464,38 @@ void Compiler::compileWhile(WhileNode* node) {
 
 void Compiler::compileFor(const ForNode* node) {
     beginScope();
-    if (node->init) compileNode(node->init.get());
+    if (node->init) compileNode(node->init);
+
+    bool constCond = false;
+    const bool isConst = foldBoolConstant(node->condition, constCond);
+    if (isConst && !constCond) {
+        compileDiscarded(node->body, true);
+        if (node->increment) compileDiscarded(NodeList(&node->increment, 1));
+        endScope();
+        return;
+    }
 
     const size_t loopStart = chunk.code.size();
-    uint8_t save = nextReg;
-    uint8_t cond = compileExpression(node->condition.get());
-
-    size_t exitJump = chunk.emitJump(OpCode::OP_JMPF, cond);
-    freeRegsTo(save);
+    chunk.loopHeaders.push_back({node, loopStart, nextReg});
+    size_t exitJump = 0;
+    if (!isConst) {
+        uint8_t save = nextReg;
+        uint8_t cond = compileExpression(node->condition);
+        exitJump = chunk.emitJump(OpCode::OP_JMPF, cond);
+        freeRegsTo(save);
+    }
 
-    loopStack.push_back({0, {}, scopeDepth});
+    loopStack.push_back({LoopContext::PENDING, {}, {}, scopeDepth});
 
     beginScope();
-    for (auto& stmt : node->body) compileNode(stmt.get());
+    compileBlock(node->body);
     endScope();
 
-    loopStack.back().loopStart = chunk.code.size();
-    if (node->increment) compileNode(node->increment.get());
+    patchContinues();
+    if (node->increment) compileNode(node->increment);
 
     chunk.emitLoop(loopStart);
-    chunk.patchJump(exitJump);
+    if (!isConst) chunk.patchJump(exitJump);
 
     for (size_t breakJump : loopStack.back().breakJumps) {
         chunk.patchJump(breakJump);
@@ -182,17 +505,46 @@ void Compiler::compileFor(const ForNode* node) {
 }
 
 void Compiler::compileRepeat(RepeatNode* node) {
+    int count;
+    const bool isConst = foldIntConstant(node->count, count);
+    // Never runs (dead-function analysis skips this body as well)
+    if (isConst && count <= 0) {
+        compileDiscarded(node->body, true);
+        return;
+    }
+    if (isConst && optimize && !containsFunctionDecl(node->body)) {
+        const auto unroll = planUnroll(count, std::max(1, estimateCost(node->body)));
+        if (unroll && unroll->blocks == 0) {
+            loopStack.push_back({LoopContext::PENDING, {}, {}, scopeDepth});
+            for (int i = 0; i < unroll->copies; i++) compileIteration(node->body);
+            for (size_t breakJump : loopStack.back().breakJumps) chunk.patchJump(breakJump);
+            loopStack.pop_back();
+            return;
+        }
+        if (unroll) {
+            compileRepeatLoop(nullptr, unroll->blocks, unroll->copies, unroll->remainder, node->body);
+            return;
+        }
+    }
+    compileRepeatLoop(node->count, 0, 1, 0, node->body);
+}
+
+/** @brief Name of the hidden repeat counters; no token interns to it, and the innermost one shadows the rest. */
+static constexpr Symbol REPEAT_COUNTER = NO_SYMBOL - 1;
+
+void Compiler::compileRepeatLoop(ExpressionNode* countExpr, int blocks, int copies, int remainder,
+                                 NodeList body) {
     beginScope();
-    const std::string counterName = "$__repeat_" + std::to_string(repeatCounter++);
-    addLocal(counterName, true);
+    addLocal(REPEAT_COUNTER, true);
 
-    int counterIdx = resolveLocal(counterName);
+    int counterIdx = resolveLocal(REPEAT_COUNTER);
     uint8_t counterReg = locals[counterIdx].reg;
 
-    compileExpression(node->count.get(), counterReg);
+    if (countExpr) compileExpression(countExpr, counterReg);
+    else emitLoadInt(counterReg, blocks);
 
     const size_t loopStart = chunk.code.size();
-    loopStack.push_back({loopStart, {}, scopeDepth});
+    loopStack.push_back({LoopContext::PENDING, {}, {}, scopeDepth});
 
     uint8_t save = nextReg;
     uint8_t zeroReg = allocReg();
@@ -203,19 +555,16 @@ void Compiler::compileRepeat(RepeatNode* node) {
     size_t exitJump = chunk.emitJump(OpCode::OP_JMPF, condReg);
     freeRegsTo(save);
 
-    beginScope();
-    for (auto& stmt : node->body) compileNode(stmt.get());
-    endScope();
+    for (int i = 0; i < copies; i++) compileIteration(body);
 
-    save = nextReg;
-    uint8_t oneReg = allocReg();
-    chunk.emit(encodeABx(OpCode::OP_LOADINT, oneReg, 1 + 32767));
-    chunk.emit(encodeABC(OpCode::OP_SUB, counterReg, counterReg, oneReg));
-    freeRegsTo(save);
+    // Only numeric counters get past the '> 0' check, so ADDI matches '- 1'.
+    chunk.emit(encodeABC(OpCode::OP_ADDI, counterReg, counterReg, static_cast<uint8_t>(-1)));
 
     chunk.emitLoop(loopStart);
     chunk.patchJump(exitJump);
 
+    for (int i = 0; i < remainder; i++) compileIteration(body);
+
     for (size_t breakJump : loopStack.back().breakJumps) {
         chunk.patchJump(breakJump);
     }
@@ -223,6 +572,20 @@ void Compiler::compileRepeat(RepeatNode* node) {
     endScope();
 }
 
+void Compiler::compileIteration(NodeList body) {
+    beginScope();
+    compileBlock(body);
+    endScope();
+    patchContinues();
+}
+
+void Compiler::patchContinues() {
+    for (size_t continueJump : loopStack.back().continueJumps) {
+        chunk.patchJump(continueJump);
+    }
+    loopStack.back().continueJumps.clear();
+}
+
 void Compiler::compileBreak() {
     if (loopStack.empty()) throw std::runtime_error("'break' outside loop");
     loopStack.back().breakJumps.push_back(chunk.emitJump(OpCode::OP_JMP));
@@ -230,17 +593,162 @@ void Compiler::compileBreak() {
 
 void Compiler::compileContinue() {
     if (loopStack.empty()) throw std::runtime_error("'continue' outside loop");
-    chunk.emitLoop(loopStack.back().loopStart);
+    auto& loop = loopStack.back();
+    if (loop.loopStart == LoopContext::PENDING) loop.continueJumps.push_back(chunk.emitJump(OpCode::OP_JMP));
+    else chunk.emitLoop(loop.loopStart);
+}
+
+uint16_t Compiler::declareGlobal(const Symbol name) {
+    auto it = globalIndex.find(name);
+    if (it != globalIndex.end()) return it->second;
+    globalIndex[name] = globalCount;
+    return globalCount++;
 }
 
 void Compiler::compileFunctionDecl(FunctionDeclNode* node) {
+    if (const auto it = precompiled.find(node); it != precompiled.end()) {
+        PrecompiledBody& body = it->second;
+        FunctionObject& func = functions[body.funcIdx];
+        functionIndex[node->name] = body.funcIdx;
+        if (body.ready) {
+            func.chunk = std::move(body.chunk);
+            func.chunk.moveConstantsTo(constants);
+            func.maxRegs = body.maxRegs;
+            finishFunctionBody(body.funcIdx);
+        } else {
+            compileFunctionBody(body.funcIdx);
+        }
+        precompiled.erase(it);
+        return;
+    }
+
+    // Functions never called from reachable code are compiled as well, so they report their errors;
+    // compile() drops their code. A nested declaration only exists once its parent's body is compiled.
+    const uint16_t funcIdx = registerFunction(node);
+    if (!options.lazyFunctions || containsFunctionDecl(node->body)) compileFunctionBody(funcIdx);
+}
+
+void Compiler::importFunction(const Symbol name, const FunctionObject& exported, const int module) {
+    if (functions.size() > UINT16_MAX) throw std::runtime_error("Too many functions");
+    if (functionIndex.contains(name)) throw std::runtime_error("Function '" + exported.name + "' is imported twice");
+
+    const auto funcIdx = static_cast<uint16_t>(functions.size());
+    functionIndex[name] = funcIdx;
+    FunctionObject& func = functions.emplace_back();
+    func.name = exported.name;
+    func.arity = exported.arity;
+    func.maxRegs = 0;
+    func.returnType = exported.returnType;
+    func.paramTypes = exported.paramTypes;
+    // Not compiled here, so never evaluated at compile time; purity still counts for callers
+    func.pure = exported.pure;
+    func.index = funcIdx;
+    func.importedFrom = module;
+}
+
+uint16_t Compiler::registerFunction(FunctionDeclNode* node) {
+    // Call sites address functions with a 16-bit index
+    if (functions.size() > UINT16_MAX) throw std::runtime_error("Too many functions");
+    if (const auto it = functionIndex.find(node->name); it != functionIndex.end() && functions[it->second].importedFrom >= 0) {
+        throw std::runtime_error("Function '" + symbols->name(node->name) + "' is already imported");
+    }
+
     uint16_t funcIdx = static_cast<uint16_t>(functions.size());
+    if (const auto it = functionIndex.find(node->name); it != functionIndex.end()) shadowedFunctions[funcIdx] = it->second;
     functionIndex[node->name] = funcIdx;
-    functions.push_back({});
+    FunctionObject& func = functions.emplace_back();
+
+    func.name = symbols->name(node->name);
+    func.arity = static_cast<int>(node->params.size());
+    func.returnType = node->returnType;
+    // Store param types for call-site checking
+    func.paramTypes.reserve(node->params.size());
+    for (auto& [pname, ptype] : node->params)
+        func.paramTypes.push_back(ptype);
+    func.decl = node;
+    func.memoize = node->memoize;
+    // A function declared in a body sees what that body does, including the functions it declares
+    func.scope = scope.functions == UINT32_MAX ? NameScope{funcIdx + 1u, UINT32_MAX, globalCount} : scope;
+
+    func.index = funcIdx;
+    return funcIdx;
+}
+
+std::optional<uint16_t> Compiler::findFunction(const Symbol name) const {
+    const auto it = functionIndex.find(name);
+    if (it == functionIndex.end()) return std::nullopt;
+    uint16_t funcIdx = it->second;
+    // Declared after the body: it calls the function the name meant before, if any
+    while (funcIdx >= scope.functions && funcIdx < scope.bodyFunctions) {
+        const auto shadowed = shadowedFunctions.find(funcIdx);
+        if (shadowed == shadowedFunctions.end()) return std::nullopt;
+        funcIdx = shadowed->second;
+    }
+    return funcIdx;
+}
+
+std::optional<uint16_t> Compiler::findGlobal(const Symbol name) const {
+    const auto it = globalIndex.find(name);
+    if (it == globalIndex.end() || it->second >= scope.globals) return std::nullopt;
+    return it->second;
+}
+
+void Compiler::ensureCompiled(const uint16_t funcIdx) {
+    // Imported functions are compiled with their module; one being compiled may call back into itself
+    if (!functions[funcIdx].compiled && functions[funcIdx].importedFrom < 0 &&
+        std::ranges::find(compiling, funcIdx) == compiling.end()) compileFunctionBody(funcIdx);
+}
+
+void Compiler::compileFunctionBody(const uint16_t funcIdx) {
+    FunctionObject& func = functions[funcIdx];
+
+    // Tiered execution starts functions unoptimized; hot ones are recompiled in the background
+    const bool savedOptimize = optimize;
+    optimize = !options.baselineFunctions;
+    const NameScope savedScope = scope;
+    scope = func.scope;
+    scope.bodyFunctions = std::min(scope.bodyFunctions, static_cast<uint32_t>(functions.size()));
+    compiling.push_back(funcIdx);
+    func.maxRegs = compileBodyChunk(func.decl, func.chunk);
+    compiling.pop_back();
+    if (optimize) func.maxRegs = RegisterAllocator(func.chunk, func.arity).allocate(func.maxRegs);
+    optimize = savedOptimize;
+    scope = savedScope;
+    finishFunctionBody(funcIdx);
+}
+
+void Compiler::finishFunctionBody(const uint16_t funcIdx) {
+    FunctionObject& func = functions[funcIdx];
+    // Nested declarations would register functions from the background thread
+    func.tier = !options.baselineFunctions || containsFunctionDecl(func.decl->body) ? TierState::Final : TierState::Baseline;
+
+    func.compiled = true;
+    func.pure = isPureChunk(func.chunk, funcIdx, functions);
+    func.specializable = canSpecialize(func.chunk, func.arity);
+    if (func.memoize && !func.pure) unprovenMemos.push_back(funcIdx);
+
+    // Purity of callees decides whether caching is sound: lazy ones are compiled now, and a
+    // call back into a body still being compiled is proven once that body is done
+    for (const uint16_t memo : std::exchange(unprovenMemos, {})) {
+        std::unordered_set<uint16_t> visited;
+        switch (provePure(memo, visited)) {
+            case Purity::Pure:
+                functions[memo].pure = true;
+                break;
+            case Purity::Impure:
+                throw std::runtime_error("@memo function '" + functions[memo].name + "' has side effects");
+            case Purity::Unknown:
+                unprovenMemos.push_back(memo);
+                break;
+        }
+    }
+}
 
+uint8_t Compiler::compileBodyChunk(FunctionDeclNode* node, Chunk& out) {
     // Save compiler state
     Chunk savedChunk = std::move(chunk);
     std::vector<Local> savedLocals = std::move(locals);
+    auto savedAssignedNames = std::move(assignedNames);
     int savedScopeDepth = scopeDepth;
     auto savedLoopStack = std::move(loopStack);
     uint8_t savedNextReg = nextReg;
@@ -248,7 +756,10 @@ void Compiler::compileFunctionDecl(FunctionDeclNode* node) {
 
     // Reset for new function
     chunk = Chunk{};
+    chunk.constants = constants;
     locals.clear();
+    assignedNames.clear();
+    collectAssigned(node->body, assignedNames);
     scopeDepth = 0;
     loopStack.clear();
     nextReg = 0;
@@ -263,37 +774,187 @@ void Compiler::compileFunctionDecl(FunctionDeclNode* node) {
             chunk.emit(encodeABC(OpCode::OP_TYPECHECK, locals[idx].reg, static_cast<uint8_t>(ptype), 0));
         }
     }
-    for (auto& stmt : node->body) compileNode(stmt.get());
-
-    // Implicit return null
-    uint8_t nullReg = allocReg();
-    chunk.emit(encodeABC(OpCode::OP_LOADNULL, nullReg, 0, 0));
-    chunk.emit(encodeABC(OpCode::OP_RET, nullReg, 0, 0));
+    // Implicit return null, unless every path already returned
+    if (!compileBlock(node->body)) {
+        uint8_t nullReg = allocReg();
+        chunk.emit(encodeABC(OpCode::OP_LOADNULL, nullReg, 0, 0));
+        chunk.emit(encodeABC(OpCode::OP_RET, nullReg, 0, 0));
+    }
 
-    functions[funcIdx].name = node->name;
-    functions[funcIdx].arity = static_cast<int>(node->params.size());
-    functions[funcIdx].chunk = std::move(chunk);
-    functions[funcIdx].maxRegs = maxReg;
-    functions[funcIdx].returnType = node->returnType;
-    // Store param types for call-site checking
-    functions[funcIdx].paramTypes.reserve(node->params.size());
-    for (auto& [pname, ptype] : node->params)
-        functions[funcIdx].paramTypes.push_back(ptype);
+    out = std::move(chunk);
+    const uint8_t frameSize = maxReg;
 
     // Restore state
     chunk = std::move(savedChunk);
     locals = std::move(savedLocals);
+    assignedNames = std::move(savedAssignedNames);
     scopeDepth = savedScopeDepth;
     loopStack = std::move(savedLoopStack);
     nextReg = savedNextReg;
     maxReg = savedMaxReg;
+    return frameSize;
+}
+
+std::unique_ptr<Compiler> Compiler::fork(const FunctionObject* declared) const {
+    CompileOptions forkOptions;
+    // Evaluation would run functions the VM may be executing at the same time
+    forkOptions.evaluatePureCalls = false;
+    forkOptions.keepAllFunctions = options.keepAllFunctions;
+    auto copy = std::make_unique<Compiler>(forkOptions);
+    copy->symbols = symbols;
+    copy->functionIndex = functionIndex;
+    copy->globalIndex = globalIndex;
+    copy->shadowedFunctions = shadowedFunctions;
+    if (declared) copy->scope = declared->scope;
+    copy->globalCount = globalCount;
+    copy->liveFunctions = liveFunctions;
+    // A pool of its own: the running program may add to the shared one (see TierUpWorker::install)
+    return copy;
+}
+
+void Compiler::precompileFunctions(NodeList stmts) {
+    size_t declared = 0;
+    for (ASTNode* stmt : stmts) {
+        if (stmt->getType() == StmtType::FunctionDecl) declared++;
+    }
+    if (declared < PARALLEL_MIN_FUNCTIONS || workerCount(declared) < 2) return;
+
+    struct Job {
+        FunctionDeclNode* decl;
+        PrecompiledBody* body;
+        size_t position; ///< Number of top-level statements before the declaration
+    };
+    std::vector<Job> jobs;
+    // Top-level statement after which each global slot was last declared (0: before the program)
+    std::vector<size_t> slotDeclaredAt(globalCount, 0);
+
+    // Walk the top level as compileProgram() will, assigning function indices and global slots
+    const auto savedFunctionIndex = functionIndex;
+    const auto savedGlobalIndex = globalIndex;
+    const uint16_t savedGlobalCount = globalCount;
+    for (size_t position = 0; position < stmts.size(); position++) {
+        ASTNode* stmt = stmts[position];
+        if (stmt->getType() == StmtType::FunctionDecl) {
+            auto* decl = static_cast<FunctionDeclNode*>(stmt);
+            PrecompiledBody& body = precompiled[decl];
+            body.funcIdx = registerFunction(decl);
+            // Nested declarations register functions, which only the main compiler may do
+            if (!containsFunctionDecl(decl->body)) jobs.push_back({decl, &body, position});
+        } else if (stmt->getType() == StmtType::VarDecl) {
+            auto* var = static_cast<VarDeclNode*>(stmt);
+            const uint16_t slot = declareGlobal(var->nameOfVariable);
+            slotDeclaredAt.resize(globalCount, 0);
+            slotDeclaredAt[slot] = position + 1;
+        } else if (containsFunctionDecl(NodeList(&stmts[position], 1))) {
+            // Functions declared in a block get their index from compileProgram(), after these
+            break;
+        }
+        if (alwaysExits(stmt)) break;
+    }
+
+    const size_t workers = workerCount(jobs.size());
+    std::vector<std::unique_ptr<Compiler>> forks;
+    for (size_t w = 0; w < workers; w++) forks.push_back(fork());
+    functionIndex = savedFunctionIndex;
+    globalIndex = savedGlobalIndex;
+    globalCount = savedGlobalCount;
+
+    parallelFor(jobs.size(), workers, [&](const size_t i, const size_t worker) {
+        const Job& job = jobs[i];
+        Compiler& compiler = *forks[worker];
+        PrecompiledBody& body = *job.body;
+        try {
+            // A small pool per body, merged into the program's by compileFunctionDecl()
+            compiler.constants = std::make_shared<ConstantPool>();
+            compiler.skippedEvaluation = false;
+            compiler.optimize = !options.baselineFunctions;
+            body.maxRegs = compiler.compileBodyChunk(job.decl, body.chunk);
+            if (compiler.optimize) {
+                body.maxRegs = RegisterAllocator(body.chunk, static_cast<int>(job.decl->params.size())).allocate(body.maxRegs);
+            }
+        } catch (const std::exception&) {
+            // Compiled again in program order, which reports the error where it belongs
+            return;
+        }
+        if (compiler.skippedEvaluation) return;
+
+        // Names must resolve as they did at the declaration: no later function or global
+        for (const uint32_t instr : body.chunk.code) {
+            switch (DECODE_OP(instr)) {
+                case OpCode::OP_CALL:
+                    if (body.chunk.callSites[DECODE_Bx(instr)].funcIdx > body.funcIdx) return;
+                    break;
+                case OpCode::OP_GGLOB:
+                case OpCode::OP_SGLOB:
+                case OpCode::OP_DGLOB:
+                    if (slotDeclaredAt[DECODE_Bx(instr)] > job.position) return;
+                    break;
+                default:
+                    break;
+            }
+        }
+        body.ready = true;
+    });
+}
+
+OptimizedBody Compiler::compileOptimized(FunctionDeclNode* decl, const int arity,
+                                         const std::vector<LoopHeader>& baselineHeaders) {
+    OptimizedBody body;
+    optimize = true;
+    const uint8_t frameSize = compileBodyChunk(decl, body.chunk);
+
+    // Loops that occur once in both versions and hold the same locals can be entered mid-run
+    std::vector<std::pair<const LoopHeader*, const LoopHeader*>> matches;
+    for (const LoopHeader& opt : body.chunk.loopHeaders) {
+        const auto sameLoop = [&opt](const LoopHeader& h) { return h.loop == opt.loop; };
+        if (std::ranges::count_if(body.chunk.loopHeaders, sameLoop) != 1) continue;
+        if (std::ranges::count_if(baselineHeaders, sameLoop) != 1) continue;
+        const LoopHeader& base = *std::ranges::find_if(baselineHeaders, sameLoop);
+        if (base.liveRegs == opt.liveRegs) matches.emplace_back(&base, &opt);
+    }
+
+    std::vector<size_t> trackedPcs;
+    for (auto& [base, opt] : matches) trackedPcs.push_back(opt->pc);
+    RegisterAllocator allocator(body.chunk, arity, trackedPcs);
+    body.maxRegs = allocator.allocate(frameSize);
+
+    for (size_t k = 0; k < matches.size(); k++) {
+        auto [base, opt] = matches[k];
+        std::vector<int> regMap = allocator.registerMap(k);
+        regMap.resize(base->liveRegs, -1);
+        body.osrEntries.push_back({base->pc, opt->pc, std::move(regMap)});
+    }
+    return body;
+}
+
+std::unique_ptr<FunctionObject> Compiler::compileReplacement(FunctionDeclNode* decl, const FunctionObject& current,
+                                                             const std::deque<FunctionObject>& functions) {
+    // A nested declaration would register a function the running program does not have
+    if (containsFunctionDecl(decl->body)) throw std::runtime_error("functions declared inside '" + current.name + "' cannot be reloaded");
+
+    auto body = std::make_unique<FunctionObject>();
+    body->name = current.name;
+    body->arity = static_cast<int>(decl->params.size());
+    body->returnType = decl->returnType;
+    for (auto& [pname, ptype] : decl->params) body->paramTypes.push_back(ptype);
+    body->decl = decl;
+    body->memoize = decl->memoize;
+
+    optimize = true;
+    body->maxRegs = compileBodyChunk(decl, body->chunk);
+    body->maxRegs = RegisterAllocator(body->chunk, body->arity).allocate(body->maxRegs);
+    body->compiled = true;
+    body->pure = isPureChunk(body->chunk, current.index, functions);
+    body->specializable = canSpecialize(body->chunk, body->arity);
+    body->index = current.index;
+    return body;
 }
 
 void Compiler::compileReturn(ReturnNode* node) {
     const uint8_t save = nextReg;
     uint8_t r;
     if (node->expression) {
-        r = compileExpression(node->expression.get());
+        r = compileExpression(node->expression);
     } else {
         r = allocReg();
         chunk.emit(encodeABC(OpCode::OP_LOADNULL, r, 0, 0));
@@ -303,50 +964,120 @@ void Compiler::compileReturn(ReturnNode* node) {
 }
 
 uint8_t Compiler::compileFunctionCall(FunctionCallNode* node, uint8_t dst) {
-    if (node->name == "print") {
+    if (node->name == Sym::Print) {
         if (node->args.size() != 1) throw std::runtime_error("print() expects 1 arg");
         uint8_t save = nextReg;
-        uint8_t r = compileExpression(node->args[0].get());
+        uint8_t r = compileExpression(node->args[0]);
         chunk.emit(encodeABC(OpCode::OP_LOG, r, 0, 0));
         freeRegsTo(save);
         chunk.emit(encodeABC(OpCode::OP_LOADNULL, dst, 0, 0));
         return dst;
     }
-    if (node->name == "wait") {
+    if (node->name == Sym::Wait) {
         if (node->args.size() != 1) throw std::runtime_error("wait() expects 1 arg");
         uint8_t save = nextReg;
-        uint8_t r = compileExpression(node->args[0].get());
+        uint8_t r = compileExpression(node->args[0]);
         chunk.emit(encodeABC(OpCode::OP_WAIT, r, 0, 0));
         freeRegsTo(save);
         chunk.emit(encodeABC(OpCode::OP_LOADNULL, dst, 0, 0));
         return dst;
     }
 
-    auto it = functionIndex.find(node->name);
-    if (it == functionIndex.end()) throw std::runtime_error("Undefined function: " + node->name);
+    const auto funcIdx = findFunction(node->name);
+    if (!funcIdx) throw std::runtime_error("Undefined function: " + symbols->name(node->name));
+
+    // Pure function with constant arguments: run it now and load the result
+    if (Value result; evaluatePureCall(node, result)) {
+        emitConstant(dst, result);
+        return dst;
+    }
 
     uint8_t base = nextReg;
     for (auto& arg : node->args) {
         uint8_t r = allocReg();
-        compileExpression(arg.get(), r);
+        compileExpression(arg, r);
     }
 
-    chunk.emit(encodeABC(OpCode::OP_CALL, base, static_cast<uint8_t>(it->second & 0xFF), static_cast<uint8_t>(node->args.size())));
-    freeRegsTo(base + 1);
+    if (node->args.size() > UINT8_MAX) throw std::runtime_error("Too many arguments in call to " + symbols->name(node->name));
+    const uint16_t site = chunk.addCallSite(*funcIdx, static_cast<uint8_t>(node->args.size()));
+    chunk.emit(encodeABx(OpCode::OP_CALL, base, site));
 
+    // The result is in base; nothing of the call may stay allocated, or the next argument of an
+    // enclosing call would not follow this one
     if (dst != base) chunk.emit(encodeABC(OpCode::OP_MOVE, dst, base, 0));
+    freeRegsTo(dst == base ? base + 1 : base);
     return dst;
 }
 
+bool Compiler::evaluateConstant(ExpressionNode* expr, Value& result) {
+    switch (expr->getType()) {
+        case ExprType::Double: result = Value(static_cast<DoubleNode*>(expr)->value); return true;
+        case ExprType::String: result = Value(std::string(static_cast<StringNode*>(expr)->value)); return true;
+        case ExprType::FunctionCall: return evaluatePureCall(static_cast<FunctionCallNode*>(expr), result);
+        default: break;
+    }
+    if (int i; foldIntConstant(expr, i)) {
+        result = Value(i);
+        return true;
+    }
+    if (bool b; foldBoolConstant(expr, b)) {
+        result = Value(b);
+        return true;
+    }
+    return false;
+}
+
+bool Compiler::evaluatePureCall(FunctionCallNode* node, Value& result) {
+    if (!optimize) return false;
+    const auto funcIdx = findFunction(node->name);
+    if (!funcIdx) return false;
+    if (!options.evaluatePureCalls) {
+        // A compiler that evaluates might have replaced this call (see precompileFunctions)
+        skippedEvaluation = skippedEvaluation || std::ranges::all_of(node->args, [&](ExpressionNode* arg) {
+            Value value;
+            return evaluateConstant(arg, value);
+        });
+        return false;
+    }
+    const FunctionObject& func = functions[*funcIdx];
+    if (!func.compiled || !func.pure || node->args.size() != static_cast<size_t>(func.arity)) return false;
+
+    std::vector<Value> args(node->args.size());
+    for (size_t i = 0; i < args.size(); i++) {
+        if (!evaluateConstant(node->args[i], args[i])) return false;
+    }
+
+    if (!evaluator) evaluator = std::make_unique<VM>();
+    try {
+        result = evaluator->invoke(functions, *funcIdx, args, CTFE_BUDGET);
+    } catch (const std::exception&) {
+        // Errors (type checks, division by zero, budget) surface when the call runs
+        return false;
+    }
+    return true;
+}
+
+void Compiler::emitConstant(const uint8_t dst, const Value& value) {
+    switch (value.tag) {
+        case Value::TAG_INT: emitLoadInt(dst, value.asInt); return;
+        case Value::TAG_BOOL: chunk.emit(encodeABC(OpCode::OP_LOADBOOL, dst, value.asBool ? 1 : 0, 0)); return;
+        case Value::TAG_NULL: chunk.emit(encodeABC(OpCode::OP_LOADNULL, dst, 0, 0)); return;
+        default: chunk.emit(encodeABx(OpCode::OP_LOADK, dst, chunk.addConstant(value))); return;
+    }
+}
+
 uint8_t Compiler::compileNumber(NumberNode* node, uint8_t dst) {
-    int val = node->value;
-    if (val >= -32767 && val <= 32767) {
-        chunk.emit(encodeABx(OpCode::OP_LOADINT, dst, static_cast<uint16_t>(val + 32767)));
+    emitLoadInt(dst, node->value);
+    return dst;
+}
+
+void Compiler::emitLoadInt(uint8_t dst, int value) {
+    if (value >= -32767 && value <= 32767) {
+        chunk.emit(encodeABx(OpCode::OP_LOADINT, dst, static_cast<uint16_t>(value + 32767)));
     } else {
-        uint16_t ki = chunk.addConstant(Value(val));
+        uint16_t ki = chunk.addConstant(Value(value));
         chunk.emit(encodeABx(OpCode::OP_LOADK, dst, ki));
     }
-    return dst;
 }
 
 uint8_t Compiler::compileDouble(DoubleNode* node, uint8_t dst) {
@@ -361,7 +1092,7 @@ uint8_t Compiler::compileBoolean(BooleanNode* node, uint8_t dst) {
 }
 
 uint8_t Compiler::compileString(StringNode* node, uint8_t dst) {
-    uint16_t ki = chunk.addConstant(Value(node->value));
+    uint16_t ki = chunk.addConstant(Value(std::string(node->value)));
     chunk.emit(encodeABx(OpCode::OP_LOADK, dst, ki));
     return dst;
 }
@@ -373,69 +1104,150 @@ uint8_t Compiler::compileVariable(VariableNode* node, uint8_t dst) {
         if (srcReg != dst) chunk.emit(encodeABC(OpCode::OP_MOVE, dst, srcReg, 0));
         return dst;
     }
-    auto it = globalIndex.find(node->nameOfVariable);
-    if (it == globalIndex.end()) throw std::runtime_error("Undefined variable.");
-    chunk.emit(encodeABx(OpCode::OP_GGLOB, dst, it->second));
+    const auto slot = findGlobal(node->nameOfVariable);
+    if (!slot) throw std::runtime_error("Undefined variable.");
+    chunk.emit(encodeABx(OpCode::OP_GGLOB, dst, *slot));
     return dst;
 }
 
 uint8_t Compiler::compileUnaryOp(UnaryOperationNode* node, uint8_t dst) {
     uint8_t save = nextReg;
-    uint8_t r = compileExpression(node->operand.get());
-    if (node->operation == "!") chunk.emit(encodeABC(OpCode::OP_NOT, dst, r, 0));
-    else if (node->operation == "-") chunk.emit(encodeABC(OpCode::OP_NEG, dst, r, 0));
+    uint8_t r = compileExpression(node->operand);
+    if (node->operation == Sym::Bang) chunk.emit(encodeABC(OpCode::OP_NOT, dst, r, 0));
+    else if (node->operation == Sym::Minus) chunk.emit(encodeABC(OpCode::OP_NEG, dst, r, 0));
     else throw std::runtime_error("Unknown unary operator");
     freeRegsTo(save);
     return dst;
 }
 
-uint8_t Compiler::compileBinaryOp(BinaryOperationNode* node, uint8_t dst) {
-    static const std::unordered_map<std::string, OpCode> opTable = {
-        {"+", OpCode::OP_ADD}, {"-", OpCode::OP_SUB}, {"*", OpCode::OP_MUL},
-        {"/", OpCode::OP_DIV}, {"%", OpCode::OP_MOD},
-        {"==", OpCode::OP_EQ}, {"!=", OpCode::OP_NEQ},
-        {"<", OpCode::OP_LT}, {">", OpCode::OP_GT},
-        {"<=", OpCode::OP_LE}, {">=", OpCode::OP_GE},
-        {"&&", OpCode::OP_AND}, {"||", OpCode::OP_OR},
-        {"&", OpCode::OP_BIT_AND}, {"|", OpCode::OP_BIT_OR}, {"^", OpCode::OP_BIT_XOR},
-        {"<<", OpCode::OP_SHL}, {">>", OpCode::OP_SHR},
-    };
+/** @brief Generic instruction for a binary operator symbol. */
+static OpCode binaryOpCode(const Symbol op) {
+    switch (op) {
+        case Sym::Plus: return OpCode::OP_ADD;
+        case Sym::Minus: return OpCode::OP_SUB;
+        case Sym::Star: return OpCode::OP_MUL;
+        case Sym::Slash: return OpCode::OP_DIV;
+        case Sym::Percent: return OpCode::OP_MOD;
+        case Sym::Eq: return OpCode::OP_EQ;
+        case Sym::Neq: return OpCode::OP_NEQ;
+        case Sym::Lt: return OpCode::OP_LT;
+        case Sym::Gt: return OpCode::OP_GT;
+        case Sym::Le: return OpCode::OP_LE;
+        case Sym::Ge: return OpCode::OP_GE;
+        case Sym::AndAnd: return OpCode::OP_AND;
+        case Sym::OrOr: return OpCode::OP_OR;
+        case Sym::Amp: return OpCode::OP_BIT_AND;
+        case Sym::Pipe: return OpCode::OP_BIT_OR;
+        case Sym::Caret: return OpCode::OP_BIT_XOR;
+        case Sym::Shl: return OpCode::OP_SHL;
+        case Sym::Shr: return OpCode::OP_SHR;
+        default: throw std::runtime_error("Unknown binary operator");
+    }
+}
 
+uint8_t Compiler::compileBinaryOp(BinaryOperationNode* node, uint8_t dst) {
     // Constant folding
-    if (node->leftNode->getType() == ExprType::Number && node->rightNode->getType() == ExprType::Number) {
-        int a = static_cast<NumberNode*>(node->leftNode.get())->value;
-        int b = static_cast<NumberNode*>(node->rightNode.get())->value;
-        const auto& op = node->operation;
-        int result;
-        bool folded = true;
-        if (op == "+") result = a + b;
-        else if (op == "-") result = a - b;
-        else if (op == "*") result = a * b;
-        else if (op == "/" && b != 0) result = a / b;
-        else if (op == "%" && b != 0) result = a % b;
-        else folded = false;
-        if (folded) {
-            if (result >= -32767 && result <= 32767) {
-                chunk.emit(encodeABx(OpCode::OP_LOADINT, dst, static_cast<uint16_t>(result + 32767)));
-            } else {
-                uint16_t ki = chunk.addConstant(Value(result));
-                chunk.emit(encodeABx(OpCode::OP_LOADK, dst, ki));
-            }
-            return dst;
-        }
+    if (int result; foldIntConstant(node, result)) {
+        emitLoadInt(dst, result);
+        return dst;
     }
 
+    if (optimize && simplifyBinaryOp(node, dst)) return dst;
+
     uint8_t save = nextReg;
-    uint8_t rB = compileExpression(node->leftNode.get());
-    uint8_t rC = compileExpression(node->rightNode.get());
+    uint8_t rB = compileExpression(node->leftNode);
+    uint8_t rC = compileExpression(node->rightNode);
 
-    auto it = opTable.find(node->operation);
-    if (it == opTable.end()) throw std::runtime_error("Unknown binary operator");
-    chunk.emit(encodeABC(it->second, dst, rB, rC));
+    chunk.emit(encodeABC(binaryOpCode(node->operation), dst, rB, rC));
     freeRegsTo(save);
     return dst;
 }
 
+bool Compiler::simplifyBinaryOp(BinaryOperationNode* node, uint8_t dst) {
+    const Symbol op = node->operation;
+    ExpressionNode* lhs = node->leftNode;
+    ExpressionNode* rhs = node->rightNode;
+
+    // Canonicalize commutative ops so the constant ends up in the immediate operand.
+    // '+' only commutes for numbers; with strings it concatenates.
+    int k;
+    if (foldIntConstant(lhs, k) && !foldIntConstant(rhs, k) &&
+        (op == Sym::Star || (op == Sym::Plus && isNumericType(inferType(rhs))))) {
+        std::swap(lhs, rhs);
+    }
+    if (!foldIntConstant(rhs, k)) return false;
+
+    const TypeAnnotation lt = inferType(lhs);
+    const bool isInt = lt == TypeAnnotation::Int;
+
+    // Identities: the operation reduces to evaluating the left operand.
+    if (((op == Sym::Plus || op == Sym::Minus) && k == 0 && isInt) ||
+        ((op == Sym::Star || op == Sym::Slash) && k == 1 && isNumericType(lt))) {
+        compileExpression(lhs, dst);
+        return true;
+    }
+
+    OpCode emitOp;
+    int imm;
+    if (op == Sym::Plus && fitsImm8(k)) { emitOp = OpCode::OP_ADDI; imm = k; }
+    else if (op == Sym::Minus && isNumericType(lt) && fitsImm8(-k)) { emitOp = OpCode::OP_ADDI; imm = -k; }
+    else if (op == Sym::Star && isInt && isPowerOfTwo(k)) { emitOp = OpCode::OP_SHLI; imm = std::countr_zero(static_cast<unsigned>(k)); }
+    else if (op == Sym::Star && fitsImm8(k)) { emitOp = OpCode::OP_MULI; imm = k; }
+    else if (op == Sym::Slash && isInt && isPowerOfTwo(k)) { emitOp = OpCode::OP_DIVP2; imm = std::countr_zero(static_cast<unsigned>(k)); }
+    else if (op == Sym::Percent && isInt && isPowerOfTwo(k)) { emitOp = OpCode::OP_MODP2; imm = std::countr_zero(static_cast<unsigned>(k)); }
+    else if (op == Sym::Shl && k >= 0 && k < 32) { emitOp = OpCode::OP_SHLI; imm = k; }
+    else if (op == Sym::Shr && k >= 0 && k < 32) { emitOp = OpCode::OP_SHRI; imm = k; }
+    else return false;
+
+    uint8_t save = nextReg;
+    uint8_t rB = compileExpression(lhs);
+    chunk.emit(encodeABC(emitOp, dst, rB, static_cast<uint8_t>(imm)));
+    freeRegsTo(save);
+    return true;
+}
+
+TypeAnnotation Compiler::inferType(ExpressionNode* expr) {
+    switch (expr->getType()) {
+        case ExprType::Number: return TypeAnnotation::Int;
+        case ExprType::Double: return TypeAnnotation::Double;
+        case ExprType::Boolean: return TypeAnnotation::Bool;
+        case ExprType::String: return TypeAnnotation::String;
+        case ExprType::Variable: {
+            const Symbol name = static_cast<VariableNode*>(expr)->nameOfVariable;
+            // Any function may assign a global, and a redeclaration may change its type
+            if (int idx = resolveLocal(name); idx != -1) return locals[idx].knownType;
+            return TypeAnnotation::None;
+        }
+        case ExprType::UnaryOp: {
+            auto* un = static_cast<UnaryOperationNode*>(expr);
+            if (un->operation == Sym::Bang) return TypeAnnotation::Bool;
+            const TypeAnnotation t = inferType(un->operand);
+            return isNumericType(t) ? t : TypeAnnotation::None;
+        }
+        case ExprType::BinaryOp: {
+            auto* bin = static_cast<BinaryOperationNode*>(expr);
+            const Symbol op = bin->operation;
+            if (op == Sym::Eq || op == Sym::Neq || op == Sym::Lt || op == Sym::Gt || op == Sym::Le || op == Sym::Ge ||
+                op == Sym::AndAnd || op == Sym::OrOr) return TypeAnnotation::Bool;
+            if (op == Sym::Amp || op == Sym::Pipe || op == Sym::Caret || op == Sym::Shl || op == Sym::Shr) return TypeAnnotation::Int;
+            const TypeAnnotation l = inferType(bin->leftNode);
+            const TypeAnnotation r = inferType(bin->rightNode);
+            if (op == Sym::Percent) {
+                // Remainder by zero yields null, so only a non-zero constant divisor is safe.
+                int k;
+                return l == TypeAnnotation::Int && foldIntConstant(bin->rightNode, k) && k != 0
+                    ? TypeAnnotation::Int : TypeAnnotation::None;
+            }
+            if (l == TypeAnnotation::Int && r == TypeAnnotation::Int) return TypeAnnotation::Int;
+            if (isNumericType(l) && isNumericType(r)) return TypeAnnotation::Double;
+            if (op == Sym::Plus && (l == TypeAnnotation::String || r == TypeAnnotation::String)) return TypeAnnotation::String;
+            return TypeAnnotation::None;
+        }
+        default:
+            return TypeAnnotation::None;
+    }
+}
+
 void Compiler::beginScope() {
     scopeDepth++;
 }
@@ -448,16 +1260,18 @@ void Compiler::endScope() {
     }
 }
 
-void Compiler::addLocal(const std::string& name, bool isMutable, TypeAnnotation typeAnnot) {
+void Compiler::addLocal(const Symbol name, bool isMutable, TypeAnnotation typeAnnot) {
     for (auto & local : std::ranges::reverse_view(locals)) {
         if (local.depth < scopeDepth) break;
-        if (local.name == name) throw std::runtime_error("Variable redeclared: " + name);
+        if (local.name == name) throw std::runtime_error("Variable redeclared: " + symbols->name(name));
     }
     uint8_t r = allocReg();
-    locals.push_back({name, scopeDepth, isMutable, r, typeAnnot});
+    // The annotation is checked at the declaration only, so it holds while nothing assigns to the name
+    const bool keepsType = !isMutable || !assignedNames.contains(name);
+    locals.push_back({name, scopeDepth, isMutable, r, typeAnnot, keepsType ? typeAnnot : TypeAnnotation::None});
 }
 
-int Compiler::resolveLocal(const std::string& name) {
+int Compiler::resolveLocal(const Symbol name) {
     for (int i = locals.size() - 1; i >= 0; i--) {
         if (locals[i].name == name) return i;
     }
@@ -2,20 +2,67 @@
 #define COMPILER_H
 
 #include "Chunk.h"
+#include "VM.h"
 #include "../node/ASTNode.h"
+#include <deque>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 /**
  * @brief Represents a local variable during compilation.
  */
 struct Local {
-    std::string name;
+    Symbol name;
     int depth;
     bool isMutable;
     uint8_t reg;
     TypeAnnotation typeAnnot = TypeAnnotation::None; ///< Optional type constraint
+    TypeAnnotation knownType = TypeAnnotation::None; ///< Type guaranteed at runtime (locals nothing assigns to)
+};
+
+/**
+ * @brief Tiering progress of a function (see TierUpWorker).
+ */
+enum class TierState : uint8_t {
+    Baseline,  ///< Running unoptimized code; calls and back-edges are counted
+    Queued,    ///< Waiting for the background compile
+    Optimized, ///< FunctionObject::optimized holds the re-optimized body
+    Final,     ///< Compiled at full optimization, or not eligible for tier-up
+};
+
+/**
+ * @brief Entry into optimized code at a loop header of the baseline code.
+ */
+struct OsrEntry {
+    size_t baselinePc;
+    size_t optimizedPc;
+    std::vector<int> regMap; ///< New register of each baseline register live at the header, or -1
+};
+
+/**
+ * @brief Options that select how much work the compiler does.
+ */
+struct CompileOptions {
+    bool lazyFunctions = false;     ///< Function bodies are compiled by ensureCompiled() on their first call
+    bool baselineFunctions = false; ///< Function bodies are compiled without optimizations (tiered execution)
+    bool evaluatePureCalls = true;  ///< Pure calls with constant arguments are evaluated at compile time
+    bool parallelFunctions = true;  ///< Top-level function bodies are compiled on worker threads (eager mode)
+    bool keepAllFunctions = false;  ///< Functions the program never calls are compiled too (the host may call them)
+    bool resolvesImports = false;   ///< The caller registers imported functions (ModuleLoader); import emits no code
+};
+
+/**
+ * @brief Names a function body may use: those declared before it, as in a compile in program
+ * order. Lazy and tier-up compiles run when later ones are in the tables as well.
+ */
+struct NameScope {
+    uint32_t functions = UINT32_MAX;     ///< Functions below this index are visible...
+    uint32_t bodyFunctions = UINT32_MAX; ///< ...and those from this one on, declared inside the body
+    uint32_t globals = UINT32_MAX;       ///< Global slots below this are visible
 };
 
 /**
@@ -28,6 +75,32 @@ struct FunctionObject {
     uint8_t maxRegs;
     TypeAnnotation returnType = TypeAnnotation::None;         ///< Expected return type
     std::vector<TypeAnnotation> paramTypes;                   ///< Expected type per parameter
+    FunctionDeclNode* decl = nullptr;                         ///< Source of the body (kept for lazy compilation)
+    bool compiled = false;                                    ///< False until the body has been compiled to chunk
+    bool pure = false;                                        ///< No globals, I/O or waits; calls only pure functions
+    bool memoize = false;                                     ///< Results are cached by the VM (@memo)
+    bool specializable = false;                               ///< Argument types could narrow its generic ops
+    uint64_t signature = 0;                                   ///< Argument types a specialized clone was built for
+    std::vector<std::unique_ptr<FunctionObject>> specializations; ///< Clones per hot argument signature
+
+    uint16_t index = 0;                                       ///< Position in the function table (shared by clones)
+    int importedFrom = -1;                                    ///< Stands for the function of this name in the program's n-th import (never run)
+    bool dead = false;                                        ///< Never called by the program: checked when compiled, then its code was dropped
+    NameScope scope;                                          ///< Functions and globals its body may use
+    TierState tier = TierState::Final;
+    uint32_t callCount = 0;
+    uint32_t backEdges = 0;
+    std::unique_ptr<FunctionObject> optimized;                ///< Re-optimized body after tier-up, or the edited one (--watch)
+    std::vector<OsrEntry> osrEntries;                         ///< Loop entries from the baseline body (optimized only)
+};
+
+/**
+ * @brief A function body compiled on its own by a forked compiler.
+ */
+struct OptimizedBody {
+    Chunk chunk;
+    uint8_t maxRegs;
+    std::vector<OsrEntry> osrEntries;
 };
 
 /**
@@ -36,54 +109,192 @@ struct FunctionObject {
  */
 class Compiler {
     Chunk chunk;
-    int repeatCounter = 0;
     std::vector<Local> locals;
+    std::unordered_set<Symbol> assignedNames; ///< Names the body being compiled assigns to anywhere
     int scopeDepth = 0;
 
     uint8_t nextReg = 0;
     uint8_t maxReg = 0;
 
     struct LoopContext {
+        /** @brief loopStart value while the continue target lies ahead and is patched later. */
+        static constexpr size_t PENDING = SIZE_MAX;
+
         size_t loopStart;
         std::vector<size_t> breakJumps;
+        std::vector<size_t> continueJumps;
         int scopeDepthAtLoop;
     };
+
     std::vector<LoopContext> loopStack;
 
-    std::vector<FunctionObject> functions;
-    std::unordered_map<std::string, uint16_t> functionIndex;
-    std::unordered_map<std::string, uint16_t> globalIndex;
+    /** @brief Calls plus loop iterations a compile-time evaluation may take before it is abandoned. */
+    static constexpr uint64_t CTFE_BUDGET = 100000;
+    std::unique_ptr<VM> evaluator; ///< Embedded VM for compile-time evaluation, created on first use
+
+    std::shared_ptr<ConstantPool> constants; ///< Shared by the chunks of all functions
+    /** @brief Deque so that running frames keep valid pointers while lazy bodies add functions. */
+    std::deque<FunctionObject> functions;
+    std::shared_ptr<const SymbolTable> symbols; ///< Spellings of the program's Symbols (for messages)
+    std::unordered_map<Symbol, uint16_t> functionIndex;
+    std::unordered_map<Symbol, uint16_t> globalIndex;
+    std::unordered_map<uint16_t, uint16_t> shadowedFunctions; ///< Function -> the earlier one of its name it rebound
     uint16_t globalCount = 0;
+    std::unordered_set<Symbol> liveFunctions; ///< Functions reachable from the main program
+    bool streaming = false; ///< Compiling batch by batch: later batches may call any function, so all are kept
+
+    /** @brief Fewer top-level functions are compiled on the main thread; starting workers would cost more. */
+    static constexpr size_t PARALLEL_MIN_FUNCTIONS = 8;
+
+    /** @brief Body of a top-level function compiled ahead by precompileFunctions(). */
+    struct PrecompiledBody {
+        uint16_t funcIdx;
+        bool ready = false; ///< False if the body has to be compiled again in program order
+        Chunk chunk;        ///< LOADK operands index the pool of the worker's compiler
+        uint8_t maxRegs = 0;
+    };
+    std::unordered_map<const FunctionDeclNode*, PrecompiledBody> precompiled;
+    bool skippedEvaluation = false; ///< A call was not evaluated only because evaluatePureCalls is off
+    std::vector<uint16_t> compiling; ///< Functions whose bodies are being compiled, innermost last
+    std::vector<uint16_t> unprovenMemos; ///< @memo functions calling a body in compiling, checked when it is done
+    CompileOptions options;
+    bool optimize = true; ///< Strength reduction, unrolling, compile-time evaluation and register allocation
+    NameScope scope; ///< Of the function body being compiled
 
 public:
+    /** @brief Bumped whenever generated code changes meaning; cached bytecode of other versions is ignored. */
+    static constexpr uint32_t VERSION = 4;
+
+    explicit Compiler(const CompileOptions& options = {})
+        : constants(std::make_shared<ConstantPool>()), options(options) {
+        chunk.constants = constants;
+    }
+
     /**
      * @brief Compiles the entire program AST into a bytecode chunk.
      * @return The main chunk containing the compiled program.
      */
     Chunk compile(ProgramNode* program);
 
-    const std::vector<FunctionObject>& getFunctions() const { return functions; }
-    std::vector<FunctionObject>& getFunctions() { return functions; }
+    /**
+     * @brief Compiles one batch of a streamed program into its own main chunk.
+     * Globals and functions of earlier batches stay visible, so the chunks must run in order
+     * on the same VM (see VM::resume). Every declared function is kept.
+     */
+    Chunk compileBatch(ProgramNode* batch);
+
+    /**
+     * @brief Makes a function of another module callable under its name; call before compile().
+     * The entry only records the name, arity, types and purity: the module loader points
+     * calls at the module's own copy when it links the program.
+     * @param module Index of the import statement the function comes from.
+     * @throws std::runtime_error if another import already provides the name.
+     */
+    void importFunction(Symbol name, const FunctionObject& exported, int module);
+
+    const std::deque<FunctionObject>& getFunctions() const { return functions; }
+    std::deque<FunctionObject>& getFunctions() { return functions; }
+
+    /**
+     * @brief Compiles the body of a lazily registered function if that has not happened yet.
+     * Names in the body resolve as at its declaration.
+     */
+    void ensureCompiled(uint16_t funcIdx);
+
+    /**
+     * @brief Creates a compiler that resolves names like this one and always optimizes.
+     * The copy owns its tables, so it can compile on another thread.
+     * @param declared If set, names resolve as at the declaration of that function.
+     */
+    std::unique_ptr<Compiler> fork(const FunctionObject* declared = nullptr) const;
+
+    /**
+     * @brief Compiles a function body at full optimization without registering it (tier-up).
+     * Loops that also appear in baselineHeaders get OSR entries.
+     */
+    OptimizedBody compileOptimized(FunctionDeclNode* decl, int arity, const std::vector<LoopHeader>& baselineHeaders);
+
+    /**
+     * @brief Watch mode: compiles an edited declaration of a running function. Call on a fork():
+     * names resolve as at the end of the program. functions is the running program's table,
+     * read for the purity of callees.
+     * @throws std::runtime_error if the body does not compile or declares functions of its own.
+     */
+    std::unique_ptr<FunctionObject> compileReplacement(FunctionDeclNode* decl, const FunctionObject& current,
+                                                       const std::deque<FunctionObject>& functions);
 
 private:
     void compileNode(ASTNode* node);
     uint8_t compileExpression(ExpressionNode* expr, uint8_t dst = 255);
 
     void compileProgram(ProgramNode* node);
+    /**
+     * @brief Compiles statements up to and including the first one that always exits.
+     * @return True if the block always exits (control never reaches its end).
+     */
+    bool compileBlock(NodeList stmts);
+    /**
+     * @brief Compiles unreachable statements for their errors, then drops the code they emitted.
+     * @param loopBody The statements are the body of a loop that never runs ('break' and 'continue' are valid).
+     */
+    void compileDiscarded(NodeList stmts, bool loopBody = false);
     void compileRepeat(RepeatNode* node);
+    /**
+     * @brief Emits a counted loop running `copies` body copies per iteration, then `remainder` straight-line copies.
+     * The counter is initialised from countExpr, or from `blocks` if countExpr is null.
+     */
+    void compileRepeatLoop(ExpressionNode* countExpr, int blocks, int copies, int remainder,
+                           NodeList body);
+    /** @brief Compiles one copy of a loop body; 'continue' inside it jumps to the copy's end. */
+    void compileIteration(NodeList body);
+    void patchContinues();
     void compileWhile(WhileNode* node);
     void compileFor(const ForNode* node);
     void compileIf(IfNode* node);
     void compileLog(PrintNode* node);
     void compileVarDecl(VarDeclNode* node);
+    /** @brief Slot of a global declared at top level, allocated on its first declaration. */
+    uint16_t declareGlobal(Symbol name);
     void compileAssignment(AssignmentNode* node);
     void compileWait(WaitNode* node);
     void compileBreak();
+    void compileSnapshot();
+    void compileImport();
     void compileContinue();
     void compileFunctionDecl(FunctionDeclNode* node);
+    /** @brief Whether a declared function's code is kept: reachable from the main program, or all are kept. */
+    bool isLive(Symbol name) const {
+        return streaming || options.keepAllFunctions || liveFunctions.contains(name);
+    }
+    /** @brief Adds a FunctionObject for the declaration and binds its name to it. */
+    uint16_t registerFunction(FunctionDeclNode* node);
+    /** @brief Index of the function a name calls in the current scope, or nullopt if there is none. */
+    std::optional<uint16_t> findFunction(Symbol name) const;
+    /** @brief Slot of the global a name refers to in the current scope, or nullopt if there is none. */
+    std::optional<uint16_t> findGlobal(Symbol name) const;
+    void compileFunctionBody(uint16_t funcIdx);
+    /** @brief Purity, tier state and @memo checks of a function whose chunk has just been built. */
+    void finishFunctionBody(uint16_t funcIdx);
+    enum class Purity { Pure, Impure, Unknown };
+    /**
+     * @brief Purity of a function through every call it can make, for @memo; lazy callees are compiled.
+     * Unknown if it reaches a body that is still being compiled.
+     */
+    Purity provePure(uint16_t funcIdx, std::unordered_set<uint16_t>& visited);
+    /**
+     * @brief Registers the top-level functions and compiles their bodies on worker threads.
+     * Each worker compiles with the name tables as of the end of the program; a body that
+     * refers to a function or global declared after it, or where compile-time evaluation
+     * might have applied, is discarded and compiled in program order instead, so the
+     * generated code matches a single-threaded compile.
+     */
+    void precompileFunctions(NodeList stmts);
+    /** @brief Compiles a body into a fresh chunk, before register allocation. Returns the frame size. */
+    uint8_t compileBodyChunk(FunctionDeclNode* node, Chunk& out);
     void compileReturn(ReturnNode* node);
 
     uint8_t compileNumber(NumberNode* node, uint8_t dst);
+    void emitLoadInt(uint8_t dst, int value);
     uint8_t compileDouble(DoubleNode* node, uint8_t dst);
     uint8_t compileBoolean(BooleanNode* node, uint8_t dst);
     uint8_t compileString(StringNode* node, uint8_t dst);
@@ -92,6 +303,25 @@ private:
     uint8_t compileUnaryOp(UnaryOperationNode* node, uint8_t dst);
     uint8_t compileFunctionCall(FunctionCallNode* node, uint8_t dst);
 
+    /** @brief Computes the value of a constant expression, including pure calls with constant arguments. */
+    bool evaluateConstant(ExpressionNode* expr, Value& result);
+    /**
+     * @brief Runs a pure function with constant arguments in the embedded VM.
+     * @return False if the call is not pure or constant, or evaluation failed (it is then compiled normally).
+     */
+    bool evaluatePureCall(FunctionCallNode* node, Value& result);
+    /** @brief Loads a compile-time value into dst. */
+    void emitConstant(uint8_t dst, const Value& value);
+
+    /** @brief Returns the type an expression is statically known to produce, or None. */
+    TypeAnnotation inferType(ExpressionNode* expr);
+
+    /**
+     * @brief Algebraic simplification and strength reduction for ops with a constant int operand.
+     * @return True if code was emitted into dst.
+     */
+    bool simplifyBinaryOp(BinaryOperationNode* node, uint8_t dst);
+
     /** @brief Allocates a new register for temporary use. */
     uint8_t allocReg() {
         const uint8_t r = nextReg++;
@@ -107,8 +337,8 @@ private:
 
     void beginScope();
     void endScope();
-    void addLocal(const std::string& name, bool isMutable, TypeAnnotation typeAnnot = TypeAnnotation::None);
-    int resolveLocal(const std::string& name);
+    void addLocal(Symbol name, bool isMutable, TypeAnnotation typeAnnot = TypeAnnotation::None);
+    int resolveLocal(Symbol name);
     bool isGlobalScope() const { return scopeDepth == 0; }
 };
 
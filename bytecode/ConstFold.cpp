@@ -0,0 +1,74 @@
+#include "ConstFold.h"
+
+bool foldIntConstant(ExpressionNode* expr, int& out) {
+    switch (expr->getType()) {
+        case ExprType::Number:
+            out = static_cast<NumberNode*>(expr)->value;
+            return true;
+        case ExprType::UnaryOp: {
+            auto* un = static_cast<UnaryOperationNode*>(expr);
+            if (un->operation != Sym::Minus || !foldIntConstant(un->operand, out)) return false;
+            out = -out;
+            return true;
+        }
+        case ExprType::BinaryOp: {
+            auto* bin = static_cast<BinaryOperationNode*>(expr);
+            int a, b;
+            if (!foldIntConstant(bin->leftNode, a) || !foldIntConstant(bin->rightNode, b)) return false;
+            const Symbol op = bin->operation;
+            if (op == Sym::Plus) out = a + b;
+            else if (op == Sym::Minus) out = a - b;
+            else if (op == Sym::Star) out = a * b;
+            else if (op == Sym::Slash && b != 0) out = a / b;
+            else if (op == Sym::Percent && b != 0) out = a % b;
+            else if (op == Sym::Amp) out = a & b;
+            else if (op == Sym::Pipe) out = a | b;
+            else if (op == Sym::Caret) out = a ^ b;
+            else if (op == Sym::Shl && b >= 0 && b < 32) out = a << b;
+            else if (op == Sym::Shr && b >= 0 && b < 32) out = a >> b;
+            else return false;
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+bool foldBoolConstant(ExpressionNode* expr, bool& out) {
+    switch (expr->getType()) {
+        case ExprType::Boolean:
+            out = static_cast<BooleanNode*>(expr)->value;
+            return true;
+        case ExprType::UnaryOp: {
+            auto* un = static_cast<UnaryOperationNode*>(expr);
+            if (un->operation != Sym::Bang || !foldBoolConstant(un->operand, out)) return false;
+            out = !out;
+            return true;
+        }
+        case ExprType::BinaryOp: {
+            auto* bin = static_cast<BinaryOperationNode*>(expr);
+            const Symbol op = bin->operation;
+            if (bool a, b; foldBoolConstant(bin->leftNode, a) && foldBoolConstant(bin->rightNode, b)) {
+                if (op == Sym::AndAnd) out = a && b;
+                else if (op == Sym::OrOr) out = a || b;
+                else if (op == Sym::Eq) out = a == b;
+                else if (op == Sym::Neq) out = a != b;
+                else return false;
+                return true;
+            }
+            if (int a, b; foldIntConstant(bin->leftNode, a) && foldIntConstant(bin->rightNode, b)) {
+                if (op == Sym::Eq) out = a == b;
+                else if (op == Sym::Neq) out = a != b;
+                else if (op == Sym::Lt) out = a < b;
+                else if (op == Sym::Gt) out = a > b;
+                else if (op == Sym::Le) out = a <= b;
+                else if (op == Sym::Ge) out = a >= b;
+                else return false;
+                return true;
+            }
+            return false;
+        }
+        default:
+            return false;
+    }
+}
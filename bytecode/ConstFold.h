@@ -0,0 +1,19 @@
+#ifndef CONSTFOLD_H
+#define CONSTFOLD_H
+
+#include "../node/ASTNode.h"
+
+/**
+ * @brief Evaluates an int expression made only of literals at compile time.
+ * @return False if the expression is not a foldable int constant.
+ */
+bool foldIntConstant(ExpressionNode* expr, int& out);
+
+/**
+ * @brief Evaluates a boolean expression made only of literals at compile time.
+ * Handles true/false, '!', '&&', '||' and comparisons of int constants.
+ * @return False if the expression is not a foldable bool constant.
+ */
+bool foldBoolConstant(ExpressionNode* expr, bool& out);
+
+#endif //CONSTFOLD_H
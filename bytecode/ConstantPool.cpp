@@ -0,0 +1,30 @@
+#include "ConstantPool.h"
+#include <bit>
+#include <stdexcept>
+
+uint16_t ConstantPool::append(const Value& value) {
+    if (values.size() > UINT16_MAX) throw std::runtime_error("Too many constants");
+    values.push_back(value);
+    return static_cast<uint16_t>(values.size() - 1);
+}
+
+uint16_t ConstantPool::add(const Value& value) {
+    switch (value.tag) {
+        case Value::TAG_INT: {
+            if (auto it = ints.find(value.asInt); it != ints.end()) return it->second;
+            return ints[value.asInt] = append(value);
+        }
+        case Value::TAG_DOUBLE: {
+            const auto bits = std::bit_cast<uint64_t>(value.asDouble);
+            if (auto it = doubles.find(bits); it != doubles.end()) return it->second;
+            return doubles[bits] = append(value);
+        }
+        case Value::TAG_STRING: {
+            if (auto it = strings.find(value.str()); it != strings.end()) return it->second;
+            // A fresh buffer, so that the pool's copy is not shared with a runtime value
+            return strings[value.str()] = append(Value(value.str()));
+        }
+        default:
+            return append(value);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef CONSTANTPOOL_H
+#define CONSTANTPOOL_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../core/Value.h"
+
+/**
+ * @brief Constants of a whole program, shared by the chunks of all its functions.
+ * Ints, doubles and strings are stored once each. Every string constant with the
+ * same text shares one buffer, so equality of two interned strings is decided by
+ * comparing pointers.
+ */
+class ConstantPool {
+    std::vector<Value> values;
+    std::unordered_map<int, uint16_t> ints;
+    std::unordered_map<uint64_t, uint16_t> doubles; ///< Keyed by bit pattern (keeps -0.0 and NaNs apart)
+    std::unordered_map<std::string, uint16_t> strings;
+
+    uint16_t append(const Value& value);
+
+public:
+    /**
+     * @brief Returns the index of the constant, adding it if it is not in the pool yet.
+     * Strings are stored as the pool's own interned copy.
+     */
+    uint16_t add(const Value& value);
+
+    const Value& operator[](size_t index) const { return values[index]; }
+    size_t size() const { return values.size(); }
+};
+
+#endif //CONSTANTPOOL_H
@@ -0,0 +1,177 @@
+#include "DeadCode.h"
+#include "ConstFold.h"
+#include <unordered_map>
+
+bool alwaysExits(ASTNode* stmt) {
+    switch (stmt->getType()) {
+        case StmtType::Return:
+        case StmtType::Break:
+        case StmtType::Continue:
+            return true;
+        case StmtType::If: {
+            auto* ifNode = static_cast<IfNode*>(stmt);
+            if (bool cond; foldBoolConstant(ifNode->condition, cond))
+                return blockAlwaysExits(cond ? ifNode->thenBlock : ifNode->elseBlock);
+            return blockAlwaysExits(ifNode->thenBlock) && blockAlwaysExits(ifNode->elseBlock);
+        }
+        default:
+            return false;
+    }
+}
+
+bool blockAlwaysExits(NodeList stmts) {
+    for (auto& stmt : stmts) {
+        if (alwaysExits(stmt)) return true;
+    }
+    return false;
+}
+
+/** @brief Worklist state for findLiveFunctions(). */
+struct LiveFunctionScan {
+    std::unordered_map<Symbol, std::vector<FunctionDeclNode*>> decls;
+    std::unordered_map<FunctionDeclNode*, FunctionDeclNode*> enclosing; ///< Nested declaration -> its parent
+    std::unordered_set<Symbol> live;
+    std::vector<Symbol> worklist;
+
+    void markLive(Symbol name);
+    void collectDecls(NodeList stmts, FunctionDeclNode* parent);
+    void scanBlock(NodeList stmts);
+    void scanStmt(ASTNode* stmt);
+    void scanExpr(ExpressionNode* expr);
+};
+
+void LiveFunctionScan::markLive(const Symbol name) {
+    if (live.insert(name).second) worklist.push_back(name);
+}
+
+void LiveFunctionScan::collectDecls(NodeList stmts, FunctionDeclNode* parent) {
+    for (auto& stmt : stmts) {
+        switch (stmt->getType()) {
+            case StmtType::FunctionDecl: {
+                auto* fn = static_cast<FunctionDeclNode*>(stmt);
+                decls[fn->name].push_back(fn);
+                if (parent) enclosing[fn] = parent;
+                collectDecls(fn->body, fn);
+                break;
+            }
+            case StmtType::Repeat: collectDecls(static_cast<RepeatNode*>(stmt)->body, parent); break;
+            case StmtType::While: collectDecls(static_cast<WhileNode*>(stmt)->body, parent); break;
+            case StmtType::For: collectDecls(static_cast<ForNode*>(stmt)->body, parent); break;
+            case StmtType::If:
+                collectDecls(static_cast<IfNode*>(stmt)->thenBlock, parent);
+                collectDecls(static_cast<IfNode*>(stmt)->elseBlock, parent);
+                break;
+            default: break;
+        }
+    }
+}
+
+void LiveFunctionScan::scanBlock(NodeList stmts) {
+    for (auto& stmt : stmts) {
+        scanStmt(stmt);
+        if (alwaysExits(stmt)) return;
+    }
+}
+
+void LiveFunctionScan::scanStmt(ASTNode* stmt) {
+    switch (stmt->getType()) {
+        case StmtType::Print: scanExpr(static_cast<PrintNode*>(stmt)->msg); return;
+        case StmtType::Wait: scanExpr(static_cast<WaitNode*>(stmt)->duration); return;
+        case StmtType::VarDecl: scanExpr(static_cast<VarDeclNode*>(stmt)->expression); return;
+        case StmtType::Assignment: scanExpr(static_cast<AssignmentNode*>(stmt)->expression); return;
+        case StmtType::Write: scanExpr(static_cast<WriteNode*>(stmt)->text); return;
+        case StmtType::Return:
+            if (auto* ret = static_cast<ReturnNode*>(stmt); ret->expression) scanExpr(ret->expression);
+            return;
+        case StmtType::Move:
+            scanExpr(static_cast<MoveNode*>(stmt)->x);
+            scanExpr(static_cast<MoveNode*>(stmt)->y);
+            return;
+        case StmtType::Shift:
+            scanExpr(static_cast<ShiftNode*>(stmt)->deltaX);
+            scanExpr(static_cast<ShiftNode*>(stmt)->deltaY);
+            return;
+        case StmtType::MouseBlock:
+            for (auto& action : static_cast<MouseBlockNode*>(stmt)->actions) scanStmt(action);
+            return;
+        case StmtType::KeyboardBlock:
+            for (auto& action : static_cast<KeyboardBlockNode*>(stmt)->actions) scanStmt(action);
+            return;
+        case StmtType::If: {
+            auto* ifNode = static_cast<IfNode*>(stmt);
+            if (bool cond; foldBoolConstant(ifNode->condition, cond)) {
+                scanBlock(cond ? ifNode->thenBlock : ifNode->elseBlock);
+                return;
+            }
+            scanExpr(ifNode->condition);
+            scanBlock(ifNode->thenBlock);
+            scanBlock(ifNode->elseBlock);
+            return;
+        }
+        case StmtType::While: {
+            auto* loop = static_cast<WhileNode*>(stmt);
+            if (bool cond; foldBoolConstant(loop->condition, cond) && !cond) return;
+            scanExpr(loop->condition);
+            scanBlock(loop->body);
+            return;
+        }
+        case StmtType::For: {
+            auto* loop = static_cast<ForNode*>(stmt);
+            if (loop->init) scanStmt(loop->init);
+            if (bool cond; foldBoolConstant(loop->condition, cond) && !cond) return;
+            scanExpr(loop->condition);
+            scanBlock(loop->body);
+            if (loop->increment) scanStmt(loop->increment);
+            return;
+        }
+        case StmtType::Repeat: {
+            auto* loop = static_cast<RepeatNode*>(stmt);
+            if (int count; foldIntConstant(loop->count, count) && count <= 0) return;
+            scanExpr(loop->count);
+            scanBlock(loop->body);
+            return;
+        }
+        default:
+            return;
+    }
+}
+
+void LiveFunctionScan::scanExpr(ExpressionNode* expr) {
+    switch (expr->getType()) {
+        case ExprType::FunctionCall: {
+            auto* call = static_cast<FunctionCallNode*>(expr);
+            markLive(call->name);
+            for (auto& arg : call->args) scanExpr(arg);
+            return;
+        }
+        case ExprType::BinaryOp:
+            scanExpr(static_cast<BinaryOperationNode*>(expr)->leftNode);
+            scanExpr(static_cast<BinaryOperationNode*>(expr)->rightNode);
+            return;
+        case ExprType::UnaryOp:
+            scanExpr(static_cast<UnaryOperationNode*>(expr)->operand);
+            return;
+        default:
+            return;
+    }
+}
+
+std::unordered_set<Symbol> findLiveFunctions(ProgramNode* program) {
+    LiveFunctionScan scan;
+    scan.collectDecls(program->statements, nullptr);
+    scan.scanBlock(program->statements);
+    while (!scan.worklist.empty()) {
+        const Symbol name = scan.worklist.back();
+        scan.worklist.pop_back();
+        auto it = scan.decls.find(name);
+        if (it == scan.decls.end()) continue;
+        for (FunctionDeclNode* fn : it->second) {
+            scan.scanBlock(fn->body);
+            // A nested function only exists once its parent has run, so the parent is live too
+            if (const auto parent = scan.enclosing.find(fn); parent != scan.enclosing.end()) {
+                scan.markLive(parent->second->name);
+            }
+        }
+    }
+    return std::move(scan.live);
+}
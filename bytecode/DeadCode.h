@@ -0,0 +1,26 @@
+#ifndef DEADCODE_H
+#define DEADCODE_H
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include "../node/ASTNode.h"
+
+/**
+ * @brief True if control never falls through the statement:
+ * return/break/continue, or an if whose reachable branches all exit.
+ */
+bool alwaysExits(ASTNode* stmt);
+
+/** @brief True if some statement of the block always exits (the rest is unreachable). */
+bool blockAlwaysExits(NodeList stmts);
+
+/**
+ * @brief Names of functions reachable from the main program.
+ * Walks exactly the code the compiler emits (skipping constant-false branches and
+ * statements after an unconditional exit) and follows calls through function bodies.
+ * A function that declares a live function is live as well.
+ */
+std::unordered_set<Symbol> findLiveFunctions(ProgramNode* program);
+
+#endif //DEADCODE_H
@@ -0,0 +1,36 @@
+#include "HotSwap.h"
+
+void HotSwap::post(std::vector<Replacement> replacements) {
+    std::lock_guard lock(mutex);
+    for (Replacement& replacement : replacements) pending.push_back(std::move(replacement));
+    ready.store(true, std::memory_order_release);
+}
+
+void HotSwap::report(const LogType type, std::string message) {
+    std::lock_guard lock(mutex);
+    reports.emplace_back(type, std::move(message));
+    ready.store(true, std::memory_order_release);
+}
+
+bool HotSwap::installPending(std::deque<FunctionObject>& functions, Logger* logger) {
+    std::vector<Replacement> posted;
+    std::vector<std::pair<LogType, std::string>> messages;
+    {
+        std::lock_guard lock(mutex);
+        posted = std::move(pending);
+        pending.clear();
+        messages = std::move(reports);
+        reports.clear();
+        ready.store(false, std::memory_order_relaxed);
+    }
+
+    for (Replacement& replacement : posted) {
+        FunctionObject& func = functions[replacement.funcIdx];
+        // Move the constants into the program's pool, as tier-up does
+        replacement.body->chunk.moveConstantsTo(func.chunk.constants);
+        if (func.optimized) retired.push_back(std::move(func.optimized));
+        func.optimized = std::move(replacement.body);
+    }
+    for (const auto& [type, message] : messages) logger->log(type, message);
+    return !posted.empty();
+}
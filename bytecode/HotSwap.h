@@ -0,0 +1,57 @@
+#ifndef HOTSWAP_H
+#define HOTSWAP_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Compiler.h"
+#include "../log/LogType.h"
+#include "../log/Logger.h"
+
+/**
+ * @brief Hands edited function bodies to a running program (--watch).
+ * Another thread posts them; the VM installs them at its next call as
+ * FunctionObject::optimized, which calls use from then on. Frames already inside a
+ * function finish in the code they started in, so replaced bodies are kept alive.
+ * Messages about reloads travel the same way: the VM thread owns the program's output.
+ */
+class HotSwap {
+public:
+    /** @brief A recompiled function; its LOADK operands still index the compiling fork's pool. */
+    struct Replacement {
+        uint16_t funcIdx;
+        std::unique_ptr<FunctionObject> body;
+    };
+
+    /** @brief Queues bodies for the next install(). Called by any thread. */
+    void post(std::vector<Replacement> replacements);
+
+    /** @brief Queues a message for the log. Called by any thread. */
+    void report(LogType type, std::string message);
+
+    /**
+     * @brief Attaches posted bodies to their functions and logs the queued messages.
+     * Called by the VM thread.
+     * @return True if any function was replaced.
+     */
+    bool install(std::deque<FunctionObject>& functions, Logger* logger) {
+        if (ready.load(std::memory_order_acquire)) [[unlikely]] return installPending(functions, logger);
+        return false;
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<Replacement> pending;
+    std::vector<std::pair<LogType, std::string>> reports;
+    std::atomic<bool> ready{false}; ///< pending or reports is not empty
+    std::vector<std::unique_ptr<FunctionObject>> retired; ///< Replaced bodies, for frames still running them
+
+    bool installPending(std::deque<FunctionObject>& functions, Logger* logger);
+};
+
+#endif //HOTSWAP_H
@@ -0,0 +1,151 @@
+#ifndef INSTRINFO_H
+#define INSTRINFO_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Chunk.h"
+#include "OpCode.h"
+
+/**
+ * @brief Static operand information for bytecode passes.
+ * Describes which registers an instruction reads and writes and where control flows next.
+ */
+
+/** @brief Returns true for instructions whose sBx operand is a relative jump. */
+inline bool isJump(OpCode op) {
+    return op == OpCode::OP_JMP || op == OpCode::OP_JMPF || op == OpCode::OP_LOOP;
+}
+
+/** @brief Returns true if execution can continue with the next instruction. */
+inline bool fallsThrough(OpCode op) {
+    return op != OpCode::OP_JMP && op != OpCode::OP_LOOP &&
+           op != OpCode::OP_RET && op != OpCode::OP_HALT;
+}
+
+/** @brief Absolute target of a jump instruction located at pc. */
+inline size_t jumpTarget(size_t pc, uint32_t instr) {
+    return static_cast<size_t>(static_cast<int64_t>(pc) + 1 + DECODE_sBx(instr));
+}
+
+/** @brief Bits returned by regFields(). */
+enum RegField : uint8_t {
+    FIELD_A = 1,
+    FIELD_B = 2,
+    FIELD_C = 4,
+};
+
+/** @brief Which of the A/B/C operand fields hold register numbers. */
+inline uint8_t regFields(OpCode op) {
+    switch (op) {
+        case OpCode::OP_MOVE:
+        case OpCode::OP_NEG:
+        case OpCode::OP_NOT:
+        case OpCode::OP_ADDI: case OpCode::OP_MULI:
+        case OpCode::OP_SHLI: case OpCode::OP_SHRI:
+        case OpCode::OP_DIVP2: case OpCode::OP_MODP2:
+        case OpCode::OP_ADDI_I:
+            return FIELD_A | FIELD_B;
+        case OpCode::OP_ADD: case OpCode::OP_SUB: case OpCode::OP_MUL:
+        case OpCode::OP_DIV: case OpCode::OP_MOD:
+        case OpCode::OP_AND: case OpCode::OP_OR:
+        case OpCode::OP_EQ: case OpCode::OP_NEQ: case OpCode::OP_LT:
+        case OpCode::OP_GT: case OpCode::OP_LE: case OpCode::OP_GE:
+        case OpCode::OP_BIT_AND: case OpCode::OP_BIT_OR: case OpCode::OP_BIT_XOR:
+        case OpCode::OP_SHL: case OpCode::OP_SHR:
+        case OpCode::OP_ADD_II: case OpCode::OP_SUB_II: case OpCode::OP_MUL_II: case OpCode::OP_DIV_II:
+        case OpCode::OP_EQ_II: case OpCode::OP_NEQ_II: case OpCode::OP_LT_II:
+        case OpCode::OP_GT_II: case OpCode::OP_LE_II: case OpCode::OP_GE_II:
+        case OpCode::OP_ADD_DD: case OpCode::OP_SUB_DD: case OpCode::OP_MUL_DD: case OpCode::OP_DIV_DD:
+        case OpCode::OP_LT_DD: case OpCode::OP_GT_DD: case OpCode::OP_LE_DD: case OpCode::OP_GE_DD:
+            return FIELD_A | FIELD_B | FIELD_C;
+        case OpCode::OP_JMP:
+        case OpCode::OP_LOOP:
+        case OpCode::OP_SNAPSHOT:
+        case OpCode::OP_HALT:
+            return 0;
+        default:
+            return FIELD_A;
+    }
+}
+
+/** @brief Returns the register written by the instruction, or -1 if none. */
+inline int instrDef(uint32_t instr) {
+    switch (DECODE_OP(instr)) {
+        case OpCode::OP_LOADK:
+        case OpCode::OP_LOADINT:
+        case OpCode::OP_LOADBOOL:
+        case OpCode::OP_LOADNULL:
+        case OpCode::OP_MOVE:
+        case OpCode::OP_ADD: case OpCode::OP_SUB: case OpCode::OP_MUL:
+        case OpCode::OP_DIV: case OpCode::OP_MOD: case OpCode::OP_NEG:
+        case OpCode::OP_NOT: case OpCode::OP_AND: case OpCode::OP_OR:
+        case OpCode::OP_EQ: case OpCode::OP_NEQ: case OpCode::OP_LT:
+        case OpCode::OP_GT: case OpCode::OP_LE: case OpCode::OP_GE:
+        case OpCode::OP_BIT_AND: case OpCode::OP_BIT_OR: case OpCode::OP_BIT_XOR:
+        case OpCode::OP_SHL: case OpCode::OP_SHR:
+        case OpCode::OP_ADDI: case OpCode::OP_MULI:
+        case OpCode::OP_SHLI: case OpCode::OP_SHRI:
+        case OpCode::OP_DIVP2: case OpCode::OP_MODP2:
+        case OpCode::OP_ADD_II: case OpCode::OP_SUB_II: case OpCode::OP_MUL_II: case OpCode::OP_DIV_II:
+        case OpCode::OP_EQ_II: case OpCode::OP_NEQ_II: case OpCode::OP_LT_II:
+        case OpCode::OP_GT_II: case OpCode::OP_LE_II: case OpCode::OP_GE_II:
+        case OpCode::OP_ADDI_I:
+        case OpCode::OP_ADD_DD: case OpCode::OP_SUB_DD: case OpCode::OP_MUL_DD: case OpCode::OP_DIV_DD:
+        case OpCode::OP_LT_DD: case OpCode::OP_GT_DD: case OpCode::OP_LE_DD: case OpCode::OP_GE_DD:
+        case OpCode::OP_GGLOB:
+        case OpCode::OP_CALL:
+            return DECODE_A(instr);
+        default:
+            return -1;
+    }
+}
+
+/**
+ * @brief Invokes f(reg) for every register operand the instruction reads.
+ * OP_CALL reads its whole argument window R[A]..R[A+argc-1]; argc comes from the chunk's call site.
+ */
+template<typename F>
+void forEachUse(const Chunk& chunk, uint32_t instr, F&& f) {
+    switch (DECODE_OP(instr)) {
+        case OpCode::OP_MOVE:
+        case OpCode::OP_NEG:
+        case OpCode::OP_NOT:
+        case OpCode::OP_ADDI: case OpCode::OP_MULI:
+        case OpCode::OP_SHLI: case OpCode::OP_SHRI:
+        case OpCode::OP_DIVP2: case OpCode::OP_MODP2:
+        case OpCode::OP_ADDI_I:
+            f(DECODE_B(instr));
+            return;
+        case OpCode::OP_ADD: case OpCode::OP_SUB: case OpCode::OP_MUL:
+        case OpCode::OP_DIV: case OpCode::OP_MOD:
+        case OpCode::OP_AND: case OpCode::OP_OR:
+        case OpCode::OP_EQ: case OpCode::OP_NEQ: case OpCode::OP_LT:
+        case OpCode::OP_GT: case OpCode::OP_LE: case OpCode::OP_GE:
+        case OpCode::OP_BIT_AND: case OpCode::OP_BIT_OR: case OpCode::OP_BIT_XOR:
+        case OpCode::OP_SHL: case OpCode::OP_SHR:
+        case OpCode::OP_ADD_II: case OpCode::OP_SUB_II: case OpCode::OP_MUL_II: case OpCode::OP_DIV_II:
+        case OpCode::OP_EQ_II: case OpCode::OP_NEQ_II: case OpCode::OP_LT_II:
+        case OpCode::OP_GT_II: case OpCode::OP_LE_II: case OpCode::OP_GE_II:
+        case OpCode::OP_ADD_DD: case OpCode::OP_SUB_DD: case OpCode::OP_MUL_DD: case OpCode::OP_DIV_DD:
+        case OpCode::OP_LT_DD: case OpCode::OP_GT_DD: case OpCode::OP_LE_DD: case OpCode::OP_GE_DD:
+            f(DECODE_B(instr));
+            f(DECODE_C(instr));
+            return;
+        case OpCode::OP_SGLOB:
+        case OpCode::OP_DGLOB:
+        case OpCode::OP_JMPF:
+        case OpCode::OP_RET:
+        case OpCode::OP_LOG:
+        case OpCode::OP_WAIT:
+        case OpCode::OP_TYPECHECK:
+            f(DECODE_A(instr));
+            return;
+        case OpCode::OP_CALL:
+            for (int i = 0; i < chunk.callSites[DECODE_Bx(instr)].argCount; i++) f(static_cast<uint8_t>(DECODE_A(instr) + i));
+            return;
+        default:
+            return;
+    }
+}
+
+#endif //INSTRINFO_H
@@ -0,0 +1,98 @@
+#include "MemoTable.h"
+#include <algorithm>
+#include <bit>
+#include <functional>
+
+MemoTable::MemoTable(const int arity) : arity(arity) {
+    hashes.assign(INITIAL_CAPACITY, 0);
+    lastUse.assign(INITIAL_CAPACITY, 0);
+    keys.resize(INITIAL_CAPACITY * arity);
+    results.resize(INITIAL_CAPACITY);
+}
+
+uint64_t MemoTable::hashArgs(const Value* args, const int count) {
+    uint64_t h = 0x9E3779B97F4A7C15ull;
+    for (int i = 0; i < count; i++) {
+        const Value& v = args[i];
+        uint64_t bits;
+        switch (v.tag) {
+            case Value::TAG_INT: bits = static_cast<uint32_t>(v.asInt); break;
+            case Value::TAG_DOUBLE: bits = std::bit_cast<uint64_t>(v.asDouble); break;
+            case Value::TAG_BOOL: bits = v.asBool; break;
+            case Value::TAG_STRING: bits = std::hash<std::string>{}(v.str()); break;
+            default: bits = 0; break;
+        }
+        // splitmix64 finalizer over (tag, payload)
+        h ^= bits + (static_cast<uint64_t>(v.tag) << 56);
+        h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 27; h *= 0x94D049BB133111EBull;
+        h ^= h >> 31;
+    }
+    return h ? h : 1;
+}
+
+bool MemoTable::matches(const size_t slot, const uint64_t hash, const Value* args) const {
+    if (hashes[slot] != hash) return false;
+    const Value* key = keys.data() + slot * arity;
+    for (int i = 0; i < arity; i++) {
+        if (key[i] != args[i]) return false;
+    }
+    return true;
+}
+
+const Value* MemoTable::find(const uint64_t hash, const Value* args) {
+    const size_t mask = capacity() - 1;
+    for (size_t p = 0; p < PROBE_LIMIT; p++) {
+        const size_t slot = (hash + p) & mask;
+        if (hashes[slot] == 0) return nullptr;
+        if (matches(slot, hash, args)) {
+            lastUse[slot] = ++clock;
+            return &results[slot];
+        }
+    }
+    return nullptr;
+}
+
+size_t MemoTable::slotFor(const uint64_t hash, const Value* args) const {
+    const size_t mask = capacity() - 1;
+    size_t victim = hash & mask;
+    for (size_t p = 0; p < PROBE_LIMIT; p++) {
+        const size_t slot = (hash + p) & mask;
+        if (hashes[slot] == 0 || matches(slot, hash, args)) return slot;
+        if (lastUse[slot] < lastUse[victim]) victim = slot;
+    }
+    return victim;
+}
+
+void MemoTable::store(const size_t slot, const uint64_t hash, const Value* args, const Value& result, const uint32_t stamp) {
+    if (hashes[slot] == 0) count++;
+    hashes[slot] = hash;
+    lastUse[slot] = stamp;
+    std::copy_n(args, arity, keys.data() + slot * arity);
+    results[slot] = result;
+}
+
+void MemoTable::insert(const uint64_t hash, const Value* args, const Value& result) {
+    if (count * 2 >= capacity() && capacity() < MAX_CAPACITY) grow();
+    store(slotFor(hash, args), hash, args, result, ++clock);
+}
+
+void MemoTable::grow() {
+    std::vector<uint64_t> oldHashes = std::move(hashes);
+    std::vector<uint32_t> oldLastUse = std::move(lastUse);
+    std::vector<Value> oldKeys = std::move(keys);
+    std::vector<Value> oldResults = std::move(results);
+
+    const size_t newCapacity = oldHashes.size() * 2;
+    hashes.assign(newCapacity, 0);
+    lastUse.assign(newCapacity, 0);
+    keys.assign(newCapacity * arity, Value());
+    results.assign(newCapacity, Value());
+    count = 0;
+
+    for (size_t slot = 0; slot < oldHashes.size(); slot++) {
+        if (oldHashes[slot] == 0) continue;
+        const Value* args = oldKeys.data() + slot * arity;
+        store(slotFor(oldHashes[slot], args), oldHashes[slot], args, oldResults[slot], oldLastUse[slot]);
+    }
+}
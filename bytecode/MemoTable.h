@@ -0,0 +1,47 @@
+#ifndef MEMOTABLE_H
+#define MEMOTABLE_H
+
+#include <cstdint>
+#include <vector>
+#include "../core/Value.h"
+
+/**
+ * @brief Bounded result cache of one @memo function, keyed on its argument Values.
+ * Open addressing with a short probe window: lookups and inserts touch at most
+ * PROBE_LIMIT slots. The table grows up to MAX_CAPACITY; once full, an insert
+ * evicts the least recently used entry of its probe window.
+ */
+class MemoTable {
+    static constexpr size_t INITIAL_CAPACITY = 64;
+    static constexpr size_t MAX_CAPACITY = 4096;
+    static constexpr size_t PROBE_LIMIT = 8;
+
+    int arity;
+    size_t count = 0;
+    uint32_t clock = 0;
+
+    std::vector<uint64_t> hashes;  ///< 0 marks an empty slot
+    std::vector<uint32_t> lastUse;
+    std::vector<Value> keys;       ///< capacity * arity argument values
+    std::vector<Value> results;
+
+    size_t capacity() const { return hashes.size(); }
+    bool matches(size_t slot, uint64_t hash, const Value* args) const;
+    /** @brief Empty or matching slot in the probe window, else its least recently used one. */
+    size_t slotFor(uint64_t hash, const Value* args) const;
+    void store(size_t slot, uint64_t hash, const Value* args, const Value& result, uint32_t stamp);
+    void grow();
+
+public:
+    explicit MemoTable(int arity);
+
+    /** @brief Hashes an argument list; never returns 0. */
+    static uint64_t hashArgs(const Value* args, int count);
+
+    /** @return The cached result, or nullptr on a miss. */
+    const Value* find(uint64_t hash, const Value* args);
+
+    void insert(uint64_t hash, const Value* args, const Value& result);
+};
+
+#endif //MEMOTABLE_H
@@ -38,6 +38,20 @@ enum class OpCode : uint8_t {
     OP_SHL,     ///< Shift Left (<<)
     OP_SHR,     ///< Shift Right (>>)
 
+    OP_ADDI,  ///< Add signed immediate. A=dst, B=src, sC=imm.
+    OP_MULI,  ///< Multiply by signed immediate. A=dst, B=src, sC=imm.
+    OP_SHLI,  ///< Shift left by immediate C.
+    OP_SHRI,  ///< Shift right by immediate C.
+    OP_DIVP2, ///< Int division by 2^C (shift, rounds toward zero).
+    OP_MODP2, ///< Int remainder by 2^C (mask, sign of dividend).
+
+    // Typed forms emitted by the specializer when both operands are known to be int (_II) or double (_DD).
+    OP_ADD_II, OP_SUB_II, OP_MUL_II, OP_DIV_II,
+    OP_EQ_II, OP_NEQ_II, OP_LT_II, OP_GT_II, OP_LE_II, OP_GE_II,
+    OP_ADDI_I, ///< ADDI on an int operand.
+    OP_ADD_DD, OP_SUB_DD, OP_MUL_DD, OP_DIV_DD,
+    OP_LT_DD, OP_GT_DD, OP_LE_DD, OP_GE_DD,
+
     OP_GGLOB, ///< Get Global.
     OP_SGLOB, ///< Set Global.
     OP_DGLOB, ///< Define Global.
@@ -46,7 +60,7 @@ enum class OpCode : uint8_t {
     OP_JMPF,  ///< Jump if False.
     OP_LOOP,  ///< Jump back (loop).
 
-    OP_CALL,  ///< Call function.
+    OP_CALL,  ///< Call function. A=window base (args, then result), Bx=call site index.
     OP_RET,   ///< Return from function.
 
     OP_LOG,      ///< Print to console.
@@ -54,6 +68,8 @@ enum class OpCode : uint8_t {
 
     OP_TYPECHECK, ///< Runtime type check. A=reg, B=expected TypeAnnotation tag. Throws on mismatch.
 
+    OP_SNAPSHOT, ///< Snapshot point (top level only). Stops the VM if it was asked to, else does nothing.
+
     OP_HALT,  ///< Stop VM.
 
     OP_COUNT
@@ -116,6 +132,9 @@ inline uint32_t encodesBx(OpCode op, int16_t sbx) {
 /** @brief Extracts operand C (bits 0-7). */
 #define DECODE_C(i)   static_cast<uint8_t>((i) & 0xFF)
 
+/** @brief Extracts operand C as a signed 8-bit immediate. */
+#define DECODE_sC(i)  static_cast<int8_t>(DECODE_C(i))
+
 /** @brief Extracts operand Bx (bits 0-15, unsigned). */
 #define DECODE_Bx(i)  static_cast<uint16_t>((i) & 0xFFFF)
 
@@ -0,0 +1,337 @@
+#include "RegAlloc.h"
+#include "InstrInfo.h"
+#include <algorithm>
+
+RegisterAllocator::RegisterAllocator(Chunk& chunk, const int arity, std::vector<size_t> trackedPcs)
+    : chunk(chunk), arity(arity), n(chunk.code.size()), tracked(std::move(trackedPcs)) {}
+
+uint8_t RegisterAllocator::allocate(const uint8_t frameSize) {
+    trackedMaps.assign(tracked.size(), std::vector<int>(256, -1));
+    if (n == 0) return frameSize;
+    computeLiveness();
+    for (size_t k = 0; k < tracked.size(); k++) {
+        for (int r = 0; r < 256; r++) {
+            if (tracked[k] < n && liveIn[tracked[k]].test(r)) trackedMaps[k][r] = r;
+        }
+    }
+    trackedWebs.assign(tracked.size(), std::vector<int>(256, -1));
+    buildWebs();
+
+    std::vector<int> roots;
+    for (int w = 0; w < static_cast<int>(webs.size()); w++) {
+        if (parent[w] == w && webs[w].end >= webs[w].start) roots.push_back(w);
+    }
+    std::ranges::stable_sort(roots, [this](int a, int b) {
+        if (webs[a].start != webs[b].start) return webs[a].start < webs[b].start;
+        return webs[a].groups.size() < webs[b].groups.size();
+    });
+
+    occupied.assign(256, {});
+    for (int w : roots) {
+        if (webs[w].pinned >= 0) place(w, webs[w].pinned);
+    }
+    for (int w : roots) {
+        if (webs[w].reg >= 0) continue;
+        if (!webs[w].groups.empty()) {
+            for (int g : webs[w].groups) {
+                if (!assignGroup(groups[g])) return frameSize;
+            }
+            continue;
+        }
+        int reg = 0;
+        while (reg < 256 && !fits(w, reg)) reg++;
+        if (reg == 256) return frameSize;
+        place(w, reg);
+    }
+
+    int newSize = 0;
+    for (int w : roots) newSize = std::max(newSize, webs[w].reg + 1);
+    if (newSize > frameSize) return frameSize;
+
+    for (size_t k = 0; k < tracked.size(); k++) {
+        for (int r = 0; r < 256; r++) {
+            if (trackedWebs[k][r] >= 0) trackedMaps[k][r] = webs[find(trackedWebs[k][r])].reg;
+        }
+    }
+    rewrite();
+    dropSelfMoves();
+    return static_cast<uint8_t>(newSize);
+}
+
+void RegisterAllocator::computeLiveness() {
+    liveIn.assign(n, {});
+    liveOut.assign(n, {});
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t pc = n; pc-- > 0;) {
+            const uint32_t instr = chunk.code[pc];
+            const OpCode op = DECODE_OP(instr);
+            RegSet out;
+            if (fallsThrough(op) && pc + 1 < n) out |= liveIn[pc + 1];
+            if (isJump(op)) {
+                const size_t target = jumpTarget(pc, instr);
+                if (target < n) out |= liveIn[target];
+            }
+            RegSet in = out;
+            if (const int def = instrDef(instr); def >= 0) in.reset(def);
+            forEachUse(chunk, instr, [&in](uint8_t r) { in.set(r); });
+            if (in != liveIn[pc] || out != liveOut[pc]) {
+                liveIn[pc] = in;
+                liveOut[pc] = out;
+                changed = true;
+            }
+        }
+    }
+}
+
+int RegisterAllocator::find(int w) {
+    while (parent[w] != w) {
+        parent[w] = parent[parent[w]];
+        w = parent[w];
+    }
+    return w;
+}
+
+void RegisterAllocator::unite(int a, int b) {
+    a = find(a);
+    b = find(b);
+    if (a == b) return;
+    if (webs[b].pinned >= 0) std::swap(a, b);
+    parent[b] = a;
+}
+
+void RegisterAllocator::extend(const int w, const int pos) {
+    webs[w].start = std::min(webs[w].start, pos);
+    webs[w].end = std::max(webs[w].end, pos);
+}
+
+void RegisterAllocator::buildWebs() {
+    defWeb.assign(n, -1);
+    useWeb.assign(n, {});
+
+    auto newWeb = [this]() {
+        webs.emplace_back();
+        parent.push_back(static_cast<int>(parent.size()));
+        return static_cast<int>(webs.size() - 1);
+    };
+
+    for (size_t pc = 0; pc < n; pc++) {
+        if (DECODE_OP(chunk.code[pc]) == OpCode::OP_CALL) groups.push_back({pc, {}, -1, {}});
+    }
+
+    RegSet present;
+    for (size_t pc = 0; pc < n; pc++) {
+        present |= liveIn[pc];
+        if (const int def = instrDef(chunk.code[pc]); def >= 0) present.set(def);
+    }
+
+    std::vector<int> webIn(n);
+    for (int r = 0; r < 256; r++) {
+        if (!present.test(r)) continue;
+
+        int entry = -1;
+        auto entryWeb = [&]() {
+            if (entry < 0) {
+                entry = newWeb();
+                if (r < arity) webs[entry].pinned = r;
+                extend(entry, -1);
+            }
+            return entry;
+        };
+
+        std::ranges::fill(webIn, -1);
+        if (liveIn[0].test(r)) webIn[0] = entryWeb();
+        for (size_t pc = 0; pc < n; pc++) {
+            if (instrDef(chunk.code[pc]) == r) defWeb[pc] = newWeb();
+        }
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t pc = 0; pc < n; pc++) {
+                const uint32_t instr = chunk.code[pc];
+                const int out = instrDef(instr) == r ? defWeb[pc] : webIn[pc];
+                if (out < 0) continue;
+                const OpCode op = DECODE_OP(instr);
+                auto flow = [&](size_t s) {
+                    if (s >= n || !liveIn[s].test(r)) return;
+                    if (webIn[s] < 0) {
+                        webIn[s] = out;
+                        changed = true;
+                    } else if (find(webIn[s]) != find(out)) {
+                        unite(webIn[s], out);
+                        changed = true;
+                    }
+                };
+                if (fallsThrough(op)) flow(pc + 1);
+                if (isJump(op)) flow(jumpTarget(pc, instr));
+            }
+        }
+
+        // Values read without a reaching definition (unreachable code) share the entry web.
+        for (size_t pc = 0; pc < n; pc++) {
+            if (liveIn[pc].test(r) && webIn[pc] < 0) webIn[pc] = entryWeb();
+        }
+        for (size_t k = 0; k < tracked.size(); k++) {
+            if (tracked[k] < n && liveIn[tracked[k]].test(r)) trackedWebs[k][r] = webIn[tracked[k]];
+        }
+
+        defStart.resize(webs.size(), 0);
+        for (size_t pc = 0; pc < n; pc++) {
+            const uint32_t instr = chunk.code[pc];
+            const int pos = static_cast<int>(pc);
+            if (liveIn[pc].test(r)) {
+                const int w = find(webIn[pc]);
+                if (pos <= webs[w].start) defStart[w] = 0;
+                extend(w, pos);
+                bool used = false;
+                forEachUse(chunk, instr, [&used, r](uint8_t u) { used |= u == r; });
+                if (used) useWeb[pc].emplace_back(static_cast<uint8_t>(r), w);
+            }
+            if (instrDef(instr) == r) {
+                const int w = find(defWeb[pc]);
+                if (pos < webs[w].start) defStart[w] = 1;
+                extend(w, pos);
+            }
+        }
+
+        for (auto& g : groups) {
+            const uint32_t instr = chunk.code[g.pc];
+            if (DECODE_A(instr) == r) {
+                g.result = find(defWeb[g.pc]);
+            } else if (liveOut[g.pc].test(r) && g.pc + 1 < n) {
+                g.liveAcross.push_back(find(webIn[g.pc + 1]));
+            }
+        }
+    }
+
+    for (int gi = 0; gi < static_cast<int>(groups.size()); gi++) {
+        auto& g = groups[gi];
+        const uint32_t instr = chunk.code[g.pc];
+        for (int k = 0; k < chunk.callSites[DECODE_Bx(instr)].argCount; k++) {
+            const auto reg = static_cast<uint8_t>(DECODE_A(instr) + k);
+            for (auto& [ur, w] : useWeb[g.pc]) {
+                if (ur == reg) g.args.push_back(w);
+            }
+        }
+        for (int w : g.args) webs[w].groups.push_back(gi);
+        webs[g.result].groups.push_back(gi);
+    }
+}
+
+bool RegisterAllocator::overlaps(const Web& a, const Web& b) const {
+    if (a.end < b.start || b.end < a.start) return false;
+    // A web that begins with its own definition may reuse the register of a web
+    // that dies at that same instruction: operands are read before the result is written.
+    if (a.end == b.start && defStart[&b - webs.data()]) return false;
+    if (b.end == a.start && defStart[&a - webs.data()]) return false;
+    return true;
+}
+
+bool RegisterAllocator::fits(const int w, const int reg) const {
+    for (int other : occupied[reg]) {
+        if (overlaps(webs[w], webs[other])) return false;
+    }
+    return true;
+}
+
+void RegisterAllocator::place(const int w, const int reg) {
+    webs[w].reg = reg;
+    occupied[reg].push_back(w);
+}
+
+bool RegisterAllocator::assignGroup(const CallGroup& g) {
+    int lower = 0;
+    for (int w : g.liveAcross) {
+        if (webs[w].reg < 0) return false;
+        lower = std::max(lower, webs[w].reg + 1);
+    }
+
+    std::vector<std::pair<int, int>> members;
+    members.emplace_back(g.result, 0);
+    for (int k = 0; k < static_cast<int>(g.args.size()); k++) members.emplace_back(g.args[k], k);
+
+    int fixedBase = -1;
+    for (auto [w, offset] : members) {
+        if (webs[w].reg < 0) continue;
+        const int b = webs[w].reg - offset;
+        if (fixedBase >= 0 && fixedBase != b) return false;
+        fixedBase = b;
+    }
+    if (fixedBase >= 0 && fixedBase < lower) return false;
+
+    const int width = std::max(1, static_cast<int>(g.args.size()));
+    for (int b = fixedBase >= 0 ? fixedBase : lower; b + width <= 256; b++) {
+        std::vector<int> placed;
+        bool ok = true;
+        for (auto [w, offset] : members) {
+            if (webs[w].reg >= 0) {
+                ok = webs[w].reg == b + offset;
+            } else if (fits(w, b + offset)) {
+                place(w, b + offset);
+                placed.push_back(w);
+            } else {
+                ok = false;
+            }
+            if (!ok) break;
+        }
+        if (ok) return true;
+        for (int w : placed) {
+            occupied[webs[w].reg].pop_back();
+            webs[w].reg = -1;
+        }
+        if (fixedBase >= 0) return false;
+    }
+    return false;
+}
+
+void RegisterAllocator::rewrite() {
+    for (size_t pc = 0; pc < n; pc++) {
+        const uint32_t instr = chunk.code[pc];
+        const uint8_t fields = regFields(DECODE_OP(instr));
+        if (!fields) continue;
+
+        auto usePhys = [&](uint8_t r) {
+            for (auto& [ur, w] : useWeb[pc]) {
+                if (ur == r) return static_cast<uint8_t>(webs[w].reg);
+            }
+            return r;
+        };
+
+        uint8_t a = DECODE_A(instr);
+        if (fields & FIELD_A) {
+            a = defWeb[pc] >= 0 ? static_cast<uint8_t>(webs[find(defWeb[pc])].reg) : usePhys(a);
+        }
+        uint32_t out = (instr & 0xFF00FFFFu) | (static_cast<uint32_t>(a) << 16);
+        if (fields & FIELD_B) out = (out & 0xFFFF00FFu) | (static_cast<uint32_t>(usePhys(DECODE_B(instr))) << 8);
+        if (fields & FIELD_C) out = (out & 0xFFFFFF00u) | usePhys(DECODE_C(instr));
+        chunk.code[pc] = out;
+    }
+}
+
+void RegisterAllocator::dropSelfMoves() {
+    std::vector<uint32_t> code;
+    code.reserve(n);
+    std::vector<size_t> newIndex(n + 1);
+    for (size_t pc = 0; pc < n; pc++) {
+        newIndex[pc] = code.size();
+        const uint32_t instr = chunk.code[pc];
+        if (DECODE_OP(instr) == OpCode::OP_MOVE && DECODE_A(instr) == DECODE_B(instr)) continue;
+        code.push_back(instr);
+    }
+    newIndex[n] = code.size();
+    if (code.size() == n) return;
+
+    for (size_t pc = 0; pc < n; pc++) {
+        const uint32_t instr = chunk.code[pc];
+        const OpCode op = DECODE_OP(instr);
+        if (!isJump(op)) continue;
+        const size_t target = newIndex[jumpTarget(pc, instr)];
+        const auto offset = static_cast<int16_t>(static_cast<int64_t>(target) - static_cast<int64_t>(newIndex[pc]) - 1);
+        code[newIndex[pc]] = encodeAsBx(op, DECODE_A(instr), offset);
+    }
+    for (LoopHeader& header : chunk.loopHeaders) header.pc = newIndex[header.pc];
+    chunk.code = std::move(code);
+    n = chunk.code.size();
+}
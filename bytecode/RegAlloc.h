@@ -0,0 +1,83 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+#include "Chunk.h"
+
+/**
+ * @brief Liveness-based linear-scan register allocator.
+ * Runs on a compiled function chunk: splits every register into live ranges (webs),
+ * then renumbers them so that ranges which never overlap share a register.
+ * Call windows stay contiguous and above every value live across the call,
+ * because the callee frame starts at the window base.
+ */
+class RegisterAllocator {
+    using RegSet = std::bitset<256>;
+
+    struct Web {
+        int start = INT32_MAX;
+        int end = -1;
+        int reg = -1;     ///< Assigned physical register.
+        int pinned = -1;  ///< Fixed register (parameters), or -1.
+        std::vector<int> groups;
+    };
+
+    struct CallGroup {
+        size_t pc;
+        std::vector<int> args;      ///< Web of each argument, in window order.
+        int result;
+        std::vector<int> liveAcross;
+    };
+
+    Chunk& chunk;
+    int arity;
+    size_t n;
+
+    std::vector<RegSet> liveIn;
+    std::vector<RegSet> liveOut;
+
+    std::vector<Web> webs;
+    std::vector<int> parent;
+    std::vector<int> defWeb;
+    std::vector<char> defStart; ///< Per web: first position is its own definition.
+    std::vector<std::vector<std::pair<uint8_t, int>>> useWeb;
+    std::vector<CallGroup> groups;
+    std::vector<std::vector<int>> occupied;
+
+    std::vector<size_t> tracked;                ///< Positions whose register mapping is reported
+    std::vector<std::vector<int>> trackedWebs;  ///< Per tracked position: web of each live register
+    std::vector<std::vector<int>> trackedMaps;
+
+    void computeLiveness();
+    void buildWebs();
+    int find(int w);
+    void unite(int a, int b);
+    void extend(int w, int pos);
+    bool overlaps(const Web& a, const Web& b) const;
+    bool fits(int w, int reg) const;
+    void place(int w, int reg);
+    bool assignGroup(const CallGroup& g);
+    void rewrite();
+    /** @brief Removes moves whose source and destination got the same register, retargeting jumps and loop headers. */
+    void dropSelfMoves();
+
+public:
+    /** @param trackedPcs Positions whose old-to-new register mapping registerMap() reports. */
+    RegisterAllocator(Chunk& chunk, int arity, std::vector<size_t> trackedPcs = {});
+
+    /**
+     * @brief Reassigns registers in place.
+     * @return The new frame size, or frameSize unchanged if the chunk was left as is.
+     */
+    uint8_t allocate(uint8_t frameSize);
+
+    /**
+     * @brief New register of every register live at the k-th tracked position (-1 if not live).
+     * Valid after allocate(); the identity if the chunk was left as is.
+     */
+    const std::vector<int>& registerMap(size_t k) const { return trackedMaps[k]; }
+};
+
+#endif //REGALLOC_H
@@ -0,0 +1,190 @@
+#include "Specializer.h"
+#include "InstrInfo.h"
+#include <array>
+
+/** @brief Register type lattice: a Value::Tag, or UNKNOWN. */
+static constexpr uint8_t UNKNOWN = 0xFF;
+using RegTypes = std::array<uint8_t, 256>;
+
+static bool isKnown(const uint8_t t) { return t != UNKNOWN; }
+/** @brief The result type tag of an operation on an operand of type t, if that type is known. */
+static uint8_t ifKnown(const uint8_t t, const uint8_t tag) { return isKnown(t) ? tag : UNKNOWN; }
+static bool isNumericType(const uint8_t t) { return t == Value::TAG_INT || t == Value::TAG_DOUBLE; }
+
+bool canSpecialize(const Chunk& chunk, const int arity) {
+    if (arity < 1 || arity > SIGNATURE_MAX_ARGS) return false;
+    for (const uint32_t instr : chunk.instructions()) {
+        switch (DECODE_OP(instr)) {
+            case OpCode::OP_ADD: case OpCode::OP_SUB: case OpCode::OP_MUL: case OpCode::OP_DIV:
+            case OpCode::OP_EQ: case OpCode::OP_NEQ: case OpCode::OP_LT:
+            case OpCode::OP_GT: case OpCode::OP_LE: case OpCode::OP_GE:
+            case OpCode::OP_ADDI:
+            case OpCode::OP_TYPECHECK:
+                return true;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+/** @brief Result type of a generic ADD/SUB/MUL/DIV, mirroring the VM handlers. */
+static uint8_t arithmeticType(const OpCode op, const uint8_t b, const uint8_t c) {
+    if (!isKnown(b) || !isKnown(c)) return UNKNOWN;
+    const bool ints = b == Value::TAG_INT && c == Value::TAG_INT;
+    if (op == OpCode::OP_ADD && !ints && !(isNumericType(b) && isNumericType(c))) return Value::TAG_STRING;
+    return ints ? Value::TAG_INT : Value::TAG_DOUBLE;
+}
+
+/** @brief Applies the effect of one instruction to the register types. */
+static void transfer(const Chunk& chunk, const uint32_t instr, RegTypes& t) {
+    const uint8_t a = DECODE_A(instr);
+    const uint8_t b = DECODE_B(instr);
+    const uint8_t c = DECODE_C(instr);
+    switch (DECODE_OP(instr)) {
+        case OpCode::OP_LOADK: t[a] = (*chunk.constants)[DECODE_Bx(instr)].tag; return;
+        case OpCode::OP_LOADINT: t[a] = Value::TAG_INT; return;
+        case OpCode::OP_LOADBOOL: t[a] = Value::TAG_BOOL; return;
+        case OpCode::OP_LOADNULL: t[a] = Value::TAG_NULL; return;
+        case OpCode::OP_MOVE: t[a] = t[b]; return;
+
+        case OpCode::OP_ADD: case OpCode::OP_SUB: case OpCode::OP_MUL: case OpCode::OP_DIV:
+            t[a] = arithmeticType(DECODE_OP(instr), t[b], t[c]);
+            return;
+        case OpCode::OP_NEG:
+            t[a] = isNumericType(t[b]) ? t[b] : ifKnown(t[b], Value::TAG_NULL);
+            return;
+
+        case OpCode::OP_NOT: case OpCode::OP_AND: case OpCode::OP_OR:
+        case OpCode::OP_EQ: case OpCode::OP_NEQ: case OpCode::OP_LT:
+        case OpCode::OP_GT: case OpCode::OP_LE: case OpCode::OP_GE:
+            t[a] = Value::TAG_BOOL;
+            return;
+
+        case OpCode::OP_BIT_AND: case OpCode::OP_BIT_OR: case OpCode::OP_BIT_XOR:
+        case OpCode::OP_SHL: case OpCode::OP_SHR:
+        case OpCode::OP_SHLI: case OpCode::OP_SHRI:
+        case OpCode::OP_DIVP2: case OpCode::OP_MODP2:
+            t[a] = Value::TAG_INT;
+            return;
+
+        case OpCode::OP_ADDI:
+            t[a] = isNumericType(t[b]) ? t[b] : ifKnown(t[b], Value::TAG_STRING);
+            return;
+        case OpCode::OP_MULI:
+            t[a] = t[b] == Value::TAG_INT ? t[b] : ifKnown(t[b], Value::TAG_DOUBLE);
+            return;
+
+        case OpCode::OP_CALL:
+            // The callee frame starts at A and may clobber every register above it
+            for (int r = a; r < 256; r++) t[r] = UNKNOWN;
+            return;
+
+        case OpCode::OP_TYPECHECK:
+            // Past the check the register holds the expected type (tags match TypeAnnotation)
+            if (b != 0) t[a] = b;
+            return;
+
+        default:
+            if (const int def = instrDef(instr); def >= 0) t[def] = UNKNOWN;
+            return;
+    }
+}
+
+/** @brief Returns the instruction with a typed opcode if the operand types allow one. */
+static uint32_t typedForm(const uint32_t instr, const RegTypes& t) {
+    const OpCode op = DECODE_OP(instr);
+    const uint8_t b = t[DECODE_B(instr)];
+    const uint8_t c = t[DECODE_C(instr)];
+    const bool ii = b == Value::TAG_INT && c == Value::TAG_INT;
+    const bool dd = b == Value::TAG_DOUBLE && c == Value::TAG_DOUBLE;
+
+    OpCode typed = op;
+    switch (op) {
+        case OpCode::OP_ADD: typed = ii ? OpCode::OP_ADD_II : dd ? OpCode::OP_ADD_DD : op; break;
+        case OpCode::OP_SUB: typed = ii ? OpCode::OP_SUB_II : dd ? OpCode::OP_SUB_DD : op; break;
+        case OpCode::OP_MUL: typed = ii ? OpCode::OP_MUL_II : dd ? OpCode::OP_MUL_DD : op; break;
+        case OpCode::OP_DIV: typed = ii ? OpCode::OP_DIV_II : dd ? OpCode::OP_DIV_DD : op; break;
+        case OpCode::OP_EQ: typed = ii ? OpCode::OP_EQ_II : op; break;
+        case OpCode::OP_NEQ: typed = ii ? OpCode::OP_NEQ_II : op; break;
+        case OpCode::OP_LT: typed = ii ? OpCode::OP_LT_II : dd ? OpCode::OP_LT_DD : op; break;
+        case OpCode::OP_GT: typed = ii ? OpCode::OP_GT_II : dd ? OpCode::OP_GT_DD : op; break;
+        case OpCode::OP_LE: typed = ii ? OpCode::OP_LE_II : dd ? OpCode::OP_LE_DD : op; break;
+        case OpCode::OP_GE: typed = ii ? OpCode::OP_GE_II : dd ? OpCode::OP_GE_DD : op; break;
+        case OpCode::OP_ADDI: typed = b == Value::TAG_INT ? OpCode::OP_ADDI_I : op; break;
+        default: break;
+    }
+    return (instr & 0x00FFFFFFu) | (static_cast<uint32_t>(typed) << 24);
+}
+
+Chunk specializeChunk(const Chunk& generic, const int arity, const uint64_t signature) {
+    const std::span<const uint32_t> code = generic.instructions();
+    const size_t n = code.size();
+
+    // Forward type inference to a fixed point; each register can only go from a type to UNKNOWN
+    std::vector<RegTypes> in(n);
+    std::vector<char> reached(n, 0);
+    std::vector<size_t> worklist;
+    if (n > 0) {
+        in[0].fill(UNKNOWN);
+        for (int i = 0; i < arity; i++) in[0][i] = static_cast<uint8_t>((signature >> (4 * i)) & 0xF);
+        reached[0] = 1;
+        worklist.push_back(0);
+    }
+    while (!worklist.empty()) {
+        const size_t pc = worklist.back();
+        worklist.pop_back();
+        const uint32_t instr = code[pc];
+        RegTypes out = in[pc];
+        transfer(generic, instr, out);
+
+        auto flow = [&](const size_t s) {
+            if (s >= n) return;
+            if (!reached[s]) {
+                in[s] = out;
+                reached[s] = 1;
+                worklist.push_back(s);
+                return;
+            }
+            bool changed = false;
+            for (int r = 0; r < 256; r++) {
+                if (in[s][r] != out[r] && in[s][r] != UNKNOWN) {
+                    in[s][r] = UNKNOWN;
+                    changed = true;
+                }
+            }
+            if (changed) worklist.push_back(s);
+        };
+        const OpCode op = DECODE_OP(instr);
+        if (fallsThrough(op)) flow(pc + 1);
+        if (isJump(op)) flow(jumpTarget(pc, instr));
+    }
+
+    // Rewrite, dropping type checks the inferred types already guarantee
+    Chunk out = generic;
+    out.image = {};
+    out.code.clear();
+    std::vector<size_t> newIndex(n + 1);
+    for (size_t pc = 0; pc < n; pc++) {
+        newIndex[pc] = out.code.size();
+        const uint32_t instr = code[pc];
+        if (!reached[pc]) {
+            out.code.push_back(instr);
+            continue;
+        }
+        if (DECODE_OP(instr) == OpCode::OP_TYPECHECK && DECODE_B(instr) != 0 &&
+            in[pc][DECODE_A(instr)] == DECODE_B(instr)) continue;
+        out.code.push_back(typedForm(instr, in[pc]));
+    }
+    newIndex[n] = out.code.size();
+
+    for (size_t pc = 0; pc < n; pc++) {
+        const uint32_t instr = code[pc];
+        const OpCode op = DECODE_OP(instr);
+        if (!isJump(op)) continue;
+        const size_t target = newIndex[jumpTarget(pc, instr)];
+        const auto offset = static_cast<int16_t>(static_cast<int64_t>(target) - static_cast<int64_t>(newIndex[pc]) - 1);
+        out.code[newIndex[pc]] = encodeAsBx(op, DECODE_A(instr), offset);
+    }
+    return out;
+}
@@ -0,0 +1,27 @@
+#ifndef SPECIALIZER_H
+#define SPECIALIZER_H
+
+#include <cstdint>
+#include "Chunk.h"
+
+/** @brief Maximum arity whose argument types fit in a signature (4 bits per argument). */
+constexpr int SIGNATURE_MAX_ARGS = 16;
+
+/** @brief Packs the Value tags of the arguments, 4 bits each. */
+inline uint64_t typeSignature(const Value* args, const int count) {
+    uint64_t signature = 0;
+    for (int i = 0; i < count; i++) signature |= static_cast<uint64_t>(args[i].tag) << (4 * i);
+    return signature;
+}
+
+/** @brief True if the chunk has generic operations that known argument types could narrow. */
+bool canSpecialize(const Chunk& chunk, int arity);
+
+/**
+ * @brief Clones a function chunk for one argument type signature.
+ * Infers register types forward from the parameters, rewrites arithmetic and comparisons
+ * on known int or double operands into typed opcodes and drops type checks that always pass.
+ */
+Chunk specializeChunk(const Chunk& generic, int arity, uint64_t signature);
+
+#endif //SPECIALIZER_H
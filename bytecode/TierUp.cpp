@@ -0,0 +1,112 @@
+#include "TierUp.h"
+#include "Specializer.h"
+#include <algorithm>
+#include <set>
+
+TierUpWorker::~TierUpWorker() {
+    if (!thread.joinable()) return;
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+void TierUpWorker::request(FunctionObject& func) {
+    func.tier = TierState::Queued;
+    Job job{func.index, func.decl, func.arity, func.chunk.loopHeaders, compiler.fork(&func)};
+    {
+        std::lock_guard lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    if (!thread.joinable()) thread = std::thread(&TierUpWorker::workerLoop, this);
+    wake.notify_one();
+}
+
+void TierUpWorker::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        Result result{job.funcIdx, true, {}};
+        try {
+            result.body = job.compiler->compileOptimized(job.decl, job.arity, job.loopHeaders);
+        } catch (const std::exception&) {
+            // The baseline body keeps running
+            result.ok = false;
+        }
+
+        std::lock_guard lock(mutex);
+        results.push_back(std::move(result));
+        ready.store(true, std::memory_order_release);
+    }
+}
+
+/** @brief Functions called and global slots accessed by a chunk. */
+static void collectReferences(const Chunk& chunk, std::set<uint16_t>& callees, std::set<uint16_t>& globals) {
+    for (const uint32_t instr : chunk.code) {
+        switch (DECODE_OP(instr)) {
+            case OpCode::OP_CALL: callees.insert(chunk.callSites[DECODE_Bx(instr)].funcIdx); break;
+            case OpCode::OP_GGLOB:
+            case OpCode::OP_SGLOB:
+            case OpCode::OP_DGLOB: globals.insert(DECODE_Bx(instr)); break;
+            default: break;
+        }
+    }
+}
+
+/**
+ * @brief True if the optimized body refers only to what the baseline body does.
+ * The fork resolves names with the tables of the moment, which differ from the
+ * baseline's when a function or global was declared again in between.
+ */
+static bool sameReferences(const Chunk& baseline, const Chunk& optimized) {
+    std::set<uint16_t> baseCallees, baseGlobals, optCallees, optGlobals;
+    collectReferences(baseline, baseCallees, baseGlobals);
+    collectReferences(optimized, optCallees, optGlobals);
+    return std::ranges::includes(baseCallees, optCallees) && std::ranges::includes(baseGlobals, optGlobals);
+}
+
+void TierUpWorker::installResults(std::deque<FunctionObject>& functions) {
+    std::vector<Result> finished;
+    {
+        std::lock_guard lock(mutex);
+        finished = std::move(results);
+        results.clear();
+        ready.store(false, std::memory_order_relaxed);
+    }
+
+    for (Result& result : finished) {
+        FunctionObject& func = functions[result.funcIdx];
+        if (!result.ok || !sameReferences(func.chunk, result.body.chunk)) {
+            func.tier = TierState::Final;
+            continue;
+        }
+
+        auto optimized = std::make_unique<FunctionObject>();
+        optimized->name = func.name;
+        optimized->arity = func.arity;
+        optimized->chunk = std::move(result.body.chunk);
+        // LOADK operands index the fork's pool; move the constants into the program's
+        optimized->chunk.moveConstantsTo(func.chunk.constants);
+        optimized->maxRegs = result.body.maxRegs;
+        optimized->returnType = func.returnType;
+        optimized->paramTypes = func.paramTypes;
+        optimized->decl = func.decl;
+        optimized->compiled = true;
+        optimized->pure = func.pure;
+        optimized->memoize = func.memoize;
+        optimized->specializable = canSpecialize(optimized->chunk, optimized->arity);
+        optimized->index = func.index;
+        optimized->osrEntries = std::move(result.body.osrEntries);
+        func.optimized = std::move(optimized);
+        func.tier = TierState::Optimized;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TIERUP_H
+#define TIERUP_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Compiler.h"
+
+/**
+ * @brief Re-optimizes hot baseline functions on a background thread.
+ * The VM counts calls and loop back-edges of baseline functions and calls request()
+ * once a threshold is crossed. The body is compiled by a forked compiler, so the
+ * running program is never blocked; install() publishes finished bodies as
+ * FunctionObject::optimized, which the VM uses from the next call on (or at the
+ * next loop back-edge through an OSR entry).
+ */
+class TierUpWorker {
+public:
+    /** @brief Calls of a baseline function before it is queued for re-optimization. */
+    static constexpr uint32_t CALL_THRESHOLD = 1000;
+    /** @brief Loop back-edges taken in a baseline function before it is queued. */
+    static constexpr uint32_t BACKEDGE_THRESHOLD = 10000;
+
+    explicit TierUpWorker(const Compiler& compiler) : compiler(compiler) {}
+    ~TierUpWorker();
+
+    TierUpWorker(const TierUpWorker&) = delete;
+    TierUpWorker& operator=(const TierUpWorker&) = delete;
+
+    /** @brief Queues a baseline function for re-optimization. Called by the VM thread. */
+    void request(FunctionObject& func);
+
+    /** @brief Attaches finished bodies to their functions. Called by the VM thread. */
+    void install(std::deque<FunctionObject>& functions) {
+        if (ready.load(std::memory_order_acquire)) [[unlikely]] installResults(functions);
+    }
+
+private:
+    struct Job {
+        uint16_t funcIdx;
+        FunctionDeclNode* decl;
+        int arity;
+        std::vector<LoopHeader> loopHeaders;
+        std::unique_ptr<Compiler> compiler;
+    };
+    struct Result {
+        uint16_t funcIdx;
+        bool ok;
+        OptimizedBody body;
+    };
+
+    const Compiler& compiler;
+    std::thread thread; ///< Started by the first request
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> jobs;
+    std::vector<Result> results;
+    std::atomic<bool> ready{false}; ///< results is not empty
+    bool stopping = false;
+
+    void workerLoop();
+    void installResults(std::deque<FunctionObject>& functions);
+};
+
+#endif //TIERUP_H
@@ -1,20 +1,147 @@
 #include "VM.h"
 #include "Compiler.h"
+#include "Specializer.h"
+#include "TierUp.h"
+#include "HotSwap.h"
 #include "../node/ASTNode.h"
+#include <algorithm>
 #include <iostream>
+#include <iterator>
 #include <stdexcept>
 
 void VM::execute(Chunk& ch, IDeviceDriver* drv, Logger* log,
-                 std::vector<FunctionObject>* funcs) {
+                 std::deque<FunctionObject>* funcs, Compiler* lazy, TierUpWorker* tierUp, HotSwap* swaps) {
     chunk = &ch;
-    ip = ch.code.data();
+    ip = ch.instructions().data();
     driver = drv;
     logger = log;
     base = stack;
-    frameCount = 0;
+    resetCalls();
     globals.clear();
     functions = funcs;
+    lazyCompiler = lazy;
+    tiering = tierUp;
+    hotSwap = swaps;
+    evalBudget = 0;
+    snapshotPc.reset();
+    run();
+}
+
+void VM::restore(Chunk& ch, const size_t pc, std::vector<Variable> state, IDeviceDriver* drv, Logger* log,
+                 std::deque<FunctionObject>* funcs) {
+    if (pc >= ch.instructions().size()) throw std::runtime_error("Snapshot does not match the program");
+    chunk = &ch;
+    ip = ch.instructions().data() + pc;
+    driver = drv;
+    logger = log;
+    base = stack;
+    resetCalls();
+    globals = std::move(state);
+    functions = funcs;
+    lazyCompiler = nullptr;
+    tiering = nullptr;
+    hotSwap = nullptr;
+    evalBudget = 0;
+    snapshotPc.reset();
+    run();
+}
+
+void VM::resume(Chunk& ch) {
+    chunk = &ch;
+    ip = ch.instructions().data();
+    base = stack;
+    resetCalls();
+    run();
+}
+
+Value VM::invoke(std::deque<FunctionObject>& funcs, const uint16_t funcIdx,
+                 const std::vector<Value>& args, const uint64_t budget) {
+    if (args.size() > UINT8_MAX) throw std::runtime_error("Too many arguments");
+    // Trampoline: the callee frame starts at stack[0], where RET leaves the result
+    Chunk trampoline;
+    trampoline.emit(encodeABx(OpCode::OP_CALL, 0, trampoline.addCallSite(funcIdx, static_cast<uint8_t>(args.size()))));
+    trampoline.emit(encodeABC(OpCode::OP_HALT, 0, 0, 0));
+    std::ranges::copy(args, stack);
+
+    chunk = &trampoline;
+    ip = trampoline.code.data();
+    base = stack;
+    resetCalls();
+    functions = &funcs;
+    lazyCompiler = nullptr;
+    tiering = nullptr;
+    hotSwap = nullptr;
+    evalBudget = budget;
     run();
+    return stack[0];
+}
+
+FunctionObject* VM::profileCallSite(CallSite& site, FunctionObject& func, const uint64_t signature) {
+    if (site.hits == 0 || site.lastSignature != signature) {
+        site.lastSignature = signature;
+        site.hits = 0;
+    }
+    if (++site.hits < SPECIALIZE_AFTER) return &func;
+    site.hits = 0;
+    site.cachedSignature = signature;
+    // After specialize(): a recursive func copies this site into the clone, which must not see it filled in
+    site.cachedTarget = specialize(func, signature);
+    site.cachedFor = &func;
+    return site.cachedTarget;
+}
+
+FunctionObject* VM::specialize(FunctionObject& func, const uint64_t signature) {
+    for (auto& clone : func.specializations) {
+        if (clone->signature == signature) return clone.get();
+    }
+    if (func.specializations.size() >= MAX_SPECIALIZATIONS) return &func;
+
+    auto clone = std::make_unique<FunctionObject>();
+    clone->name = func.name;
+    clone->arity = func.arity;
+    clone->chunk = specializeChunk(func.chunk, func.arity, signature);
+    clone->maxRegs = func.maxRegs;
+    clone->returnType = func.returnType;
+    clone->paramTypes = func.paramTypes;
+    clone->decl = func.decl;
+    clone->compiled = true;
+    clone->pure = func.pure;
+    clone->memoize = func.memoize;
+    clone->signature = signature;
+    clone->index = func.index;
+    return func.specializations.emplace_back(std::move(clone)).get();
+}
+
+bool VM::tierUpLoop(CallFrame& frame, Value* R) {
+    tiering->install(*functions);
+    FunctionObject& func = (*functions)[frame.function->index];
+    if (func.tier == TierState::Baseline && ++func.backEdges >= TierUpWorker::BACKEDGE_THRESHOLD)
+        tiering->request(func);
+    // Only the generic baseline body has the loop headers the entries refer to
+    if (frame.function != &func || !func.optimized) return false;
+
+    const FunctionObject& target = *func.optimized;
+    const size_t pc = ip - func.chunk.instructions().data();
+    const auto entry = std::ranges::find_if(target.osrEntries, [pc](const OsrEntry& e) { return e.baselinePc == pc; });
+    if (entry == target.osrEntries.end() || R + target.maxRegs > stack + STACK_MAX) return false;
+
+    // Move the live locals to the registers the optimized body keeps them in
+    std::vector<Value> live(R, R + entry->regMap.size());
+    for (size_t r = 0; r < entry->regMap.size(); r++) {
+        if (entry->regMap[r] >= 0) R[entry->regMap[r]] = live[r];
+    }
+    frame.function = &target;
+    chunk = &func.optimized->chunk;
+    ip = chunk->instructions().data() + entry->optimizedPc;
+    return true;
+}
+
+void VM::resetCalls() {
+    frameCount = 0;
+    memoTables.clear();
+    pendingMemos.clear();
+    memoArgs.clear();
+    staleMemoTables.clear();
 }
 
 // Use Computed GOTO on GCC/Clang for performance.
@@ -39,11 +166,18 @@ void VM::run() {
         &&L_NOT, &&L_AND, &&L_OR,
         &&L_EQ, &&L_NEQ, &&L_LT, &&L_GT, &&L_LE, &&L_GE,
         &&L_BIT_AND, &&L_BIT_OR, &&L_BIT_XOR, &&L_SHL, &&L_SHR,
+        &&L_ADDI, &&L_MULI, &&L_SHLI, &&L_SHRI, &&L_DIVP2, &&L_MODP2,
+        &&L_ADD_II, &&L_SUB_II, &&L_MUL_II, &&L_DIV_II,
+        &&L_EQ_II, &&L_NEQ_II, &&L_LT_II, &&L_GT_II, &&L_LE_II, &&L_GE_II,
+        &&L_ADDI_I,
+        &&L_ADD_DD, &&L_SUB_DD, &&L_MUL_DD, &&L_DIV_DD,
+        &&L_LT_DD, &&L_GT_DD, &&L_LE_DD, &&L_GE_DD,
         &&L_GGLOB, &&L_SGLOB, &&L_DGLOB,
         &&L_JMP, &&L_JMPF, &&L_LOOP,
         &&L_CALL, &&L_RET,
         &&L_LOG, &&L_WAIT,
         &&L_TYPECHECK,
+        &&L_SNAPSHOT,
         &&L_HALT,
     };
 
@@ -72,7 +206,7 @@ void VM::run() {
 
     CASE(LOADK): {
         A = DECODE_A(instr);
-        R[A] = chunk->constants[DECODE_Bx(instr)];
+        R[A] = (*chunk->constants)[DECODE_Bx(instr)];
         DISPATCH();
     }
     CASE(LOADINT): {
@@ -183,6 +317,72 @@ void VM::run() {
     CASE(SHL): { DECODE_ABC(); R[A] = Value(R[B].asInt << R[C].asInt); DISPATCH(); }
     CASE(SHR): { DECODE_ABC(); R[A] = Value(R[B].asInt >> R[C].asInt); DISPATCH(); }
 
+    CASE(ADDI): {
+        DECODE_ABC();
+        const Value& vb = R[B];
+        const int imm = DECODE_sC(instr);
+        if (vb.isInt()) R[A] = Value(vb.asInt + imm);
+        else if (vb.isDouble()) R[A] = Value(vb.asDouble + imm);
+        else R[A] = Value(toString(vb) + std::to_string(imm));
+        DISPATCH();
+    }
+    CASE(MULI): {
+        DECODE_ABC();
+        const Value& vb = R[B];
+        if (vb.isInt()) R[A] = Value(vb.asInt * DECODE_sC(instr));
+        else R[A] = numericMul(vb, Value(static_cast<int>(DECODE_sC(instr))));
+        DISPATCH();
+    }
+    CASE(SHLI): { DECODE_ABC(); R[A] = Value(R[B].asInt << C); DISPATCH(); }
+    CASE(SHRI): { DECODE_ABC(); R[A] = Value(R[B].asInt >> C); DISPATCH(); }
+    CASE(DIVP2): {
+        DECODE_ABC();
+        // Bias negative dividends so the arithmetic shift truncates toward zero like '/'.
+        const int x = R[B].asInt;
+        R[A] = Value((x + ((x >> 31) & ((1 << C) - 1))) >> C);
+        DISPATCH();
+    }
+    CASE(MODP2): {
+        DECODE_ABC();
+        const int x = R[B].asInt;
+        const int m = 1 << C;
+        int r = x & (m - 1);
+        if (x < 0 && r != 0) r -= m;
+        R[A] = Value(r);
+        DISPATCH();
+    }
+
+    CASE(ADD_II): { DECODE_ABC(); R[A] = Value(R[B].asInt + R[C].asInt); DISPATCH(); }
+    CASE(SUB_II): { DECODE_ABC(); R[A] = Value(R[B].asInt - R[C].asInt); DISPATCH(); }
+    CASE(MUL_II): { DECODE_ABC(); R[A] = Value(R[B].asInt * R[C].asInt); DISPATCH(); }
+    CASE(DIV_II): {
+        DECODE_ABC();
+        if (R[C].asInt == 0) throw std::runtime_error("Division by zero");
+        R[A] = Value(R[B].asInt / R[C].asInt);
+        DISPATCH();
+    }
+    CASE(EQ_II): { DECODE_ABC(); R[A] = Value(R[B].asInt == R[C].asInt); DISPATCH(); }
+    CASE(NEQ_II): { DECODE_ABC(); R[A] = Value(R[B].asInt != R[C].asInt); DISPATCH(); }
+    CASE(LT_II): { DECODE_ABC(); R[A] = Value(R[B].asInt < R[C].asInt); DISPATCH(); }
+    CASE(GT_II): { DECODE_ABC(); R[A] = Value(R[B].asInt > R[C].asInt); DISPATCH(); }
+    CASE(LE_II): { DECODE_ABC(); R[A] = Value(R[B].asInt <= R[C].asInt); DISPATCH(); }
+    CASE(GE_II): { DECODE_ABC(); R[A] = Value(R[B].asInt >= R[C].asInt); DISPATCH(); }
+    CASE(ADDI_I): { DECODE_ABC(); R[A] = Value(R[B].asInt + DECODE_sC(instr)); DISPATCH(); }
+
+    CASE(ADD_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble + R[C].asDouble); DISPATCH(); }
+    CASE(SUB_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble - R[C].asDouble); DISPATCH(); }
+    CASE(MUL_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble * R[C].asDouble); DISPATCH(); }
+    CASE(DIV_DD): {
+        DECODE_ABC();
+        if (R[C].asDouble == 0.0) throw std::runtime_error("Division by zero");
+        R[A] = Value(R[B].asDouble / R[C].asDouble);
+        DISPATCH();
+    }
+    CASE(LT_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble < R[C].asDouble); DISPATCH(); }
+    CASE(GT_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble > R[C].asDouble); DISPATCH(); }
+    CASE(LE_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble <= R[C].asDouble); DISPATCH(); }
+    CASE(GE_DD): { DECODE_ABC(); R[A] = Value(R[B].asDouble >= R[C].asDouble); DISPATCH(); }
+
     CASE(GGLOB): {
         A = DECODE_A(instr);
         uint16_t slot = DECODE_Bx(instr);
@@ -216,37 +416,79 @@ void VM::run() {
         DISPATCH();
     }
     CASE(LOOP): {
+        if (evalBudget && --evalBudget == 0) throw std::runtime_error("Evaluation budget exceeded");
         ip += DECODE_sBx(instr);
+        if (tiering && frameCount > 0) [[unlikely]] tierUpLoop(frames[frameCount - 1], R);
         DISPATCH();
     }
 
     CASE(CALL): {
-        DECODE_ABC();
-        uint16_t funcIdx = B;
-        uint8_t argCount = C;
+        A = DECODE_A(instr);
+        CallSite& site = chunk->callSites[DECODE_Bx(instr)];
+        uint16_t funcIdx = site.funcIdx;
+        uint8_t argCount = site.argCount;
         uint8_t callBase = A;
 
         if (!functions || funcIdx >= functions->size())
             throw std::runtime_error("Invalid function index");
+        if (evalBudget && --evalBudget == 0) throw std::runtime_error("Evaluation budget exceeded");
 
         FunctionObject& func = (*functions)[funcIdx];
+        if (!func.compiled) [[unlikely]] {
+            if (!lazyCompiler) throw std::runtime_error("Function '" + func.name + "' is not compiled");
+            lazyCompiler->ensureCompiled(funcIdx);
+        }
+        if (tiering) [[unlikely]] {
+            tiering->install(*functions);
+            if (func.tier == TierState::Baseline && ++func.callCount >= TierUpWorker::CALL_THRESHOLD)
+                tiering->request(func);
+        }
+        if (hotSwap && hotSwap->install(*functions, logger)) [[unlikely]] {
+            // Cached results may come from replaced code; calls still running complete into the old tables
+            std::ranges::move(memoTables, std::back_inserter(staleMemoTables));
+            memoTables.clear();
+        }
         if (argCount != static_cast<uint8_t>(func.arity))
             throw std::runtime_error("Function '" + func.name + "' expects " +
                 std::to_string(func.arity) + " args, got " + std::to_string(argCount));
 
-        if (frameCount >= static_cast<int>(FRAMES_MAX))
+        if (func.memoize) {
+            if (funcIdx >= memoTables.size()) memoTables.resize(funcIdx + 1);
+            if (!memoTables[funcIdx]) memoTables[funcIdx] = std::make_unique<MemoTable>(func.arity);
+            MemoTable* table = memoTables[funcIdx].get();
+            const uint64_t hash = MemoTable::hashArgs(R + callBase, argCount);
+            if (const Value* cached = table->find(hash, R + callBase)) {
+                R[callBase] = *cached;
+                DISPATCH();
+            }
+            // The callee may overwrite its argument registers, so keep a copy for the insert at RET
+            pendingMemos.push_back({table, hash, memoArgs.size()});
+            memoArgs.insert(memoArgs.end(), R + callBase, R + callBase + argCount);
+        }
+
+        // Inline cache: a clone specialized for this call site's argument types, if it is hot.
+        // Clones are built from the optimized body once tier-up or a hot swap has produced one.
+        FunctionObject& callee = func.optimized ? *func.optimized : func;
+        FunctionObject* target = &callee;
+        if (callee.specializable) {
+            const uint64_t signature = typeSignature(R + callBase, argCount);
+            if (site.cachedFor == &callee && site.cachedSignature == signature) target = site.cachedTarget;
+            else target = profileCallSite(site, callee, signature);
+        }
+
+        if (frameCount >= static_cast<int>(FRAMES_MAX) || R + callBase + target->maxRegs > stack + STACK_MAX)
             throw std::runtime_error("Stack overflow");
 
         CallFrame& frame = frames[frameCount++];
-        frame.function = &func;
+        frame.function = target;
         frame.returnIp = ip;
         frame.returnChunk = chunk;
         frame.returnBase = base;
 
         base = R + callBase;
         R = base;
-        chunk = &func.chunk;
-        ip = func.chunk.code.data();
+        chunk = &target->chunk;
+        ip = target->chunk.instructions().data();
         DISPATCH();
     }
 
@@ -256,6 +498,12 @@ void VM::run() {
 
         frameCount--;
         const CallFrame& frame = frames[frameCount];
+        if (frame.function->memoize) {
+            const PendingMemo& pending = pendingMemos.back();
+            pending.table->insert(pending.hash, memoArgs.data() + pending.argsOffset, result);
+            memoArgs.resize(pending.argsOffset);
+            pendingMemos.pop_back();
+        }
         base = frame.returnBase;
         R = base;
         ip = frame.returnIp;
@@ -311,6 +559,15 @@ void VM::run() {
         DISPATCH();
     }
 
+    CASE(SNAPSHOT): {
+        if (snapshotRequested) {
+            // Only emitted at the top level, so chunk is the main chunk and no call is active
+            snapshotPc = static_cast<size_t>(ip - chunk->instructions().data());
+            return;
+        }
+        DISPATCH();
+    }
+
     CASE(HALT): return;
 
     #undef FETCH
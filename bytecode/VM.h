@@ -1,13 +1,20 @@
 #ifndef VM_H
 #define VM_H
 
+#include <deque>
+#include <memory>
+#include <optional>
 #include <vector>
 #include "Chunk.h"
+#include "MemoTable.h"
 #include "../core/Variable.h"
 #include "../device/IDeviceDriver.h"
 #include "../log/Logger.h"
 
 struct FunctionObject;
+class Compiler;
+class TierUpWorker;
+class HotSwap;
 
 /**
  * @brief Represents a function call frame on the stack.
@@ -26,6 +33,10 @@ struct CallFrame {
 class VM {
     static constexpr size_t STACK_MAX = 16384;
     static constexpr size_t FRAMES_MAX = 256;
+    /** @brief Consecutive calls with one argument signature before a call site gets a specialized callee. */
+    static constexpr uint32_t SPECIALIZE_AFTER = 32;
+    /** @brief Specialized clones kept per function; further signatures run the generic body. */
+    static constexpr size_t MAX_SPECIALIZATIONS = 4;
 
     Value stack[STACK_MAX];
     Value* base = stack;
@@ -36,21 +47,90 @@ class VM {
     CallFrame frames[FRAMES_MAX];
     int frameCount = 0;
 
+    /** @brief A running @memo call whose result is cached when it returns. */
+    struct PendingMemo {
+        MemoTable* table;
+        uint64_t hash;
+        size_t argsOffset; ///< Start of the call's arguments in memoArgs
+    };
+    std::vector<std::unique_ptr<MemoTable>> memoTables; ///< Per function index, created on first call
+    std::vector<PendingMemo> pendingMemos;
+    std::vector<Value> memoArgs;
+    std::vector<std::unique_ptr<MemoTable>> staleMemoTables; ///< Dropped by a hot swap; pending calls still fill them
+
     IDeviceDriver* driver = nullptr;
     Logger* logger = nullptr;
 
     std::vector<Variable> globals;
-    std::vector<FunctionObject>* functions = nullptr;
+    std::deque<FunctionObject>* functions = nullptr;
+    Compiler* lazyCompiler = nullptr; ///< Compiles function bodies on their first call, if set
+    TierUpWorker* tiering = nullptr;  ///< Re-optimizes hot baseline functions, if set
+    HotSwap* hotSwap = nullptr;       ///< Supplies edited function bodies (--watch), if set
+    uint64_t evalBudget = 0;          ///< Calls plus loop iterations left for invoke(); 0 = unlimited
+    bool snapshotRequested = false;   ///< OP_SNAPSHOT stops the run (--snapshot)
+    std::optional<size_t> snapshotPc; ///< Main-chunk pc after the OP_SNAPSHOT the run stopped at
 
 public:
     /**
      * @brief Executes the given bytecode chunk.
+     * @param lazy Compiler that registered funcs lazily; bodies are compiled on their first OP_CALL.
+     * @param tierUp Worker that re-optimizes baseline functions once they are hot.
+     * @param swaps Edited function bodies, installed at the next call (--watch).
      */
     void execute(Chunk& ch, IDeviceDriver* drv, Logger* log,
-                 std::vector<FunctionObject>* funcs = nullptr);
+                 std::deque<FunctionObject>* funcs = nullptr, Compiler* lazy = nullptr,
+                 TierUpWorker* tierUp = nullptr, HotSwap* swaps = nullptr);
+
+    /**
+     * @brief Continues a program where a snapshot was taken: globals as captured, main chunk from pc.
+     * @throws std::runtime_error if pc is not inside the chunk.
+     */
+    void restore(Chunk& ch, size_t pc, std::vector<Variable> state, IDeviceDriver* drv, Logger* log,
+                 std::deque<FunctionObject>* funcs);
+
+    /** @brief Makes execute() stop at the program's snapshot statement instead of passing over it. */
+    void stopAtSnapshot() { snapshotRequested = true; }
+
+    /** @return Where the main chunk continues, if the last execute() stopped at a snapshot statement. */
+    [[nodiscard]] std::optional<size_t> snapshotPoint() const { return snapshotPc; }
+
+    [[nodiscard]] const std::vector<Variable>& getGlobals() const { return globals; }
+
+    /**
+     * @brief Runs a further main chunk after execute() has returned (streaming mode).
+     * Globals, functions and the driver of the previous run are kept.
+     */
+    void resume(Chunk& ch);
+
+    /** @brief Sets the device and log for invoke() calls that are not preceded by execute(). */
+    void attach(IDeviceDriver* drv, Logger* log) {
+        driver = drv;
+        logger = log;
+    }
+
+    /**
+     * @brief Calls a compiled function with the given arguments and returns its result.
+     * Used by the compiler to evaluate pure calls at compile time, and by ScriptInstance to call
+     * into a script from C++; globals of a previous execute() are kept.
+     * @param budget Calls plus loop iterations allowed before giving up with an exception (0 = unlimited).
+     */
+    Value invoke(std::deque<FunctionObject>& funcs, uint16_t funcIdx,
+                 const std::vector<Value>& args, uint64_t budget = 0);
 
 private:
     void run();
+    void resetCalls();
+
+    /** @brief Inline-cache miss: counts the signature and installs a specialized callee once it is hot. */
+    FunctionObject* profileCallSite(CallSite& site, FunctionObject& func, uint64_t signature);
+    /** @brief Returns the clone of func for the signature, building it if the limit allows. */
+    FunctionObject* specialize(FunctionObject& func, uint64_t signature);
+    /**
+     * @brief Counts a back-edge of the running function; moves the frame into its optimized
+     * body if one is ready and has an entry at this loop header.
+     * @return True if the frame was switched (chunk and ip now point into the optimized body).
+     */
+    bool tierUpLoop(CallFrame& frame, Value* R);
 };
 
 #endif //VM_H
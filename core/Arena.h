@@ -0,0 +1,57 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Bump allocator for objects that die together.
+ * Allocation advances a pointer through large blocks; nothing is freed individually
+ * and no destructor runs, so only trivially destructible types may be placed here.
+ * All memory is returned at once when the arena is destroyed.
+ */
+class Arena {
+    std::pmr::monotonic_buffer_resource resource;
+
+public:
+    explicit Arena(const size_t initialSize = 64 * 1024) : resource(initialSize) {}
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template<typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+        return ::new (resource.allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /** @brief Frees everything at once; pointers into the arena become invalid. */
+    void reset() { resource.release(); }
+
+    /** @brief Copies the elements into an exactly sized array owned by the arena. */
+    template<typename T>
+    std::span<const T> list(const std::vector<T>& items) {
+        static_assert(std::is_trivially_destructible_v<T>, "Arena objects are never destroyed");
+        if (items.empty()) return {};
+        auto* data = static_cast<T*>(resource.allocate(items.size() * sizeof(T), alignof(T)));
+        std::uninitialized_copy(items.begin(), items.end(), data);
+        return {data, items.size()};
+    }
+
+    /** @brief Copies the characters into the arena. */
+    std::string_view copy(const std::string_view text) {
+        if (text.empty()) return {};
+        auto* data = static_cast<char*>(resource.allocate(text.size(), 1));
+        std::memcpy(data, text.data(), text.size());
+        return {data, text.size()};
+    }
+};
+
+#endif //ARENA_H
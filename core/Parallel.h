@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/** @brief Threads parallelFor() would use for the given number of tasks (at least 1). */
+inline size_t workerCount(const size_t tasks) {
+    const size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    return std::max<size_t>(1, std::min(cores, tasks));
+}
+
+/**
+ * @brief Runs task(index, worker) for every index in [0, tasks) on `workers` threads.
+ * The calling thread is worker 0; indices are handed out one at a time, so uneven tasks
+ * balance out. Returns when all tasks are done. Tasks must not throw.
+ */
+template<typename Task>
+void parallelFor(const size_t tasks, const size_t workers, Task&& task) {
+    std::atomic<size_t> next{0};
+    auto drain = [&](const size_t worker) {
+        for (size_t i = next.fetch_add(1, std::memory_order_relaxed); i < tasks;
+             i = next.fetch_add(1, std::memory_order_relaxed)) {
+            task(i, worker);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (size_t w = 1; w < workers; w++) threads.emplace_back(drain, w);
+    drain(0);
+    for (std::thread& thread : threads) thread.join();
+}
+
+#endif //PARALLEL_H
@@ -0,0 +1,83 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+/**
+ * @brief Interned identifier, keyword or operator.
+ * Equal spellings get equal ids, so the front end compares and hashes integers.
+ */
+using Symbol = uint32_t;
+
+/** @brief Symbol of tokens that are not interned (string and number literals). */
+inline constexpr Symbol NO_SYMBOL = UINT32_MAX;
+
+/**
+ * @brief Symbols every table starts with, in this order; their ids are compile-time constants.
+ */
+namespace Sym {
+    enum : Symbol {
+        // Operators
+        Plus, Minus, Star, Slash, Percent,
+        Eq, Neq, Lt, Gt, Le, Ge,
+        AndAnd, OrOr, Amp, Pipe, Caret, Shl, Shr, Bang,
+        // Punctuation
+        LParen, RParen, LBrace, RBrace, Comma, Dot, Colon, Semicolon, Assign,
+        // Keywords and built-ins
+        Var, Val, Fun, Return, If, Else, While, For, Repeat, Break, Continue,
+        True, False, Memo, Print, Wait, Snapshot, Import,
+        Mouse, Click, Move, Shift, Keyboard, Write, Press,
+        COUNT
+    };
+
+    inline constexpr std::array<std::string_view, COUNT> spellings = {
+        "+", "-", "*", "/", "%",
+        "==", "!=", "<", ">", "<=", ">=",
+        "&&", "||", "&", "|", "^", "<<", ">>", "!",
+        "(", ")", "{", "}", ",", ".", ":", ";", "=",
+        "var", "val", "fun", "return", "if", "else", "while", "for", "repeat", "break", "continue",
+        "true", "false", "@memo", "print", "wait", "snapshot", "import",
+        "mouse", "click", "move", "shift", "keyboard", "write", "press",
+    };
+}
+
+/**
+ * @brief Maps spellings to dense Symbol ids and back.
+ * Filled while lexing; read-only afterwards, so later stages may share it across threads.
+ */
+class SymbolTable {
+    std::deque<std::string> names; ///< Deque: the map's keys view these strings
+    std::unordered_map<std::string_view, Symbol> ids;
+
+public:
+    SymbolTable() {
+        for (const std::string_view s : Sym::spellings) intern(s);
+    }
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /** @brief Returns the id of the spelling, assigning the next free one if it is new. */
+    Symbol intern(const std::string_view text) {
+        if (const auto it = ids.find(text); it != ids.end()) return it->second;
+        const auto id = static_cast<Symbol>(names.size());
+        ids.emplace(names.emplace_back(text), id);
+        return id;
+    }
+
+    /** @return The id of the spelling, or NO_SYMBOL if it has not been interned. */
+    Symbol find(const std::string_view text) const {
+        const auto it = ids.find(text);
+        return it == ids.end() ? NO_SYMBOL : it->second;
+    }
+
+    const std::string& name(const Symbol id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+};
+
+#endif //SYMBOL_H
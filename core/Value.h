@@ -46,7 +46,7 @@ struct Value {
             case TAG_INT: return asInt == o.asInt;
             case TAG_DOUBLE: return asDouble == o.asDouble;
             case TAG_BOOL: return asBool == o.asBool;
-            case TAG_STRING: return *sptr == *o.sptr;
+            case TAG_STRING: return sptr == o.sptr || *sptr == *o.sptr; // Interned constants share a buffer
         }
         return false;
     }
@@ -5,13 +5,20 @@
 #include "../log/Logger.h"
 #include "../parser/Parser.h"
 #include "../device/Win32Driver.h"
+#include "FileWatcher.h"
+#include "HotReload.h"
+#include "Script.h"
+#include "../bytecode/BytecodeCache.h"
 #include "../bytecode/Compiler.h"
+#include "../bytecode/HotSwap.h"
 #include "../bytecode/VM.h"
+#include "../bytecode/TierUp.h"
 
-Executor::Executor(const std::string &filePath) {
-    if (!filePath.ends_with(".iris"))
+Executor::Executor(const std::string &filePath, const ExecutionOptions &options) {
+    if (!filePath.ends_with(".iris") && filePath != SourceFile::STDIN_PATH)
         throw std::runtime_error("Invalid file extension");
     this->filePath = filePath;
+    this->options = options;
     this->init();
 }
 
@@ -22,14 +29,54 @@ void Executor::init() {
 }
 
 void Executor::execute() {
+    if (options.watch) {
+        if (filePath == SourceFile::STDIN_PATH) {
+            logger->error("--watch needs a script file");
+            return;
+        }
+        if (options.lazyCompile || options.tiered || options.streaming || options.writeSnapshot || options.fromSnapshot) {
+            logger->warn("--lazy, --tiered, --stream and snapshots are ignored with --watch");
+        }
+        executeWatching();
+        return;
+    }
+    if (options.writeSnapshot || options.fromSnapshot) {
+        if (filePath == SourceFile::STDIN_PATH) {
+            logger->error("Snapshots need a script file");
+            return;
+        }
+        if (options.lazyCompile || options.tiered || options.streaming) {
+            logger->warn("--lazy, --tiered and --stream are ignored with snapshots");
+        }
+        if (options.writeSnapshot) writeSnapshot();
+        else executeFromSnapshot();
+        return;
+    }
+    if (options.streaming) {
+        executeStreaming();
+        return;
+    }
+    if (!options.lazyCompile && !options.tiered) {
+        executeScript();
+        return;
+    }
+
     parser->parse();
     if (const auto program = parser->getProgram()) {
         try {
-            Compiler compiler;
+            CompileOptions compileOptions;
+            compileOptions.lazyFunctions = options.lazyCompile;
+            compileOptions.baselineFunctions = options.tiered;
+            Compiler compiler(compileOptions);
             Chunk bytecode = compiler.compile(program);
 
+            // Declared after the compiler: the worker thread is joined before the tables it forks go away
+            std::unique_ptr<TierUpWorker> tierUp;
+            if (options.tiered) tierUp = std::make_unique<TierUpWorker>(compiler);
+
             VM vm;
-            vm.execute(bytecode, driver.get(), logger.get(), &compiler.getFunctions());
+            vm.execute(bytecode, driver.get(), logger.get(), &compiler.getFunctions(),
+                       options.lazyCompile ? &compiler : nullptr, tierUp.get());
         } catch (const std::exception &e) {
             logger->error(std::string("Execution error: ") + e.what());
         }
@@ -37,3 +84,142 @@ void Executor::execute() {
         logger->error("Parsing failed");
     }
 }
+
+void Executor::executeScript() {
+    try {
+        ScriptOptions scriptOptions;
+        scriptOptions.cacheBytecode = options.cacheBytecode;
+        scriptOptions.allFunctions = false; // Nothing calls in from outside
+        const auto script = Script::compile(*parser, filePath, scriptOptions);
+        if (!script) {
+            logger->error("Parsing failed");
+            return;
+        }
+        ScriptInstance instance(script, driver.get(), logger.get());
+        instance.run();
+    } catch (const std::exception &e) {
+        logger->error(std::string("Execution error: ") + e.what());
+    }
+}
+
+void Executor::writeSnapshot() {
+    parser->parse();
+    const auto program = parser->getProgram();
+    if (!program) {
+        logger->error("Parsing failed");
+        return;
+    }
+    try {
+        Compiler compiler;
+        Chunk bytecode = compiler.compile(program);
+        VM vm;
+        vm.stopAtSnapshot();
+        vm.execute(bytecode, driver.get(), logger.get(), &compiler.getFunctions());
+        const auto resumePc = vm.snapshotPoint();
+        if (!resumePc) {
+            logger->warn("The script ended without reaching a snapshot statement; no snapshot was written");
+            return;
+        }
+        const BytecodeCache snapshot = BytecodeCache::snapshotOf(filePath, parser->getSource());
+        const BytecodeCache::State state{vm.getGlobals(), *resumePc};
+        if (!snapshot.store(bytecode, compiler.getFunctions(), {}, &state)) {
+            logger->error("Snapshot could not be written to " + snapshot.getPath());
+        }
+    } catch (const std::exception &e) {
+        logger->error(std::string("Execution error: ") + e.what());
+    }
+}
+
+void Executor::executeFromSnapshot() {
+    auto program = BytecodeCache::snapshotOf(filePath, parser->getSource()).load();
+    if (!program || !program->state) {
+        logger->warn("No snapshot of the current script; running it from the start");
+        executeScript();
+        return;
+    }
+    try {
+        VM vm;
+        vm.restore(program->main, program->state->resumePc, std::move(program->state->globals),
+                   driver.get(), logger.get(), &program->functions);
+    } catch (const std::exception &e) {
+        logger->error(std::string("Execution error: ") + e.what());
+    }
+}
+
+void Executor::executeWatching() {
+    FileWatcher watcher(filePath);
+    while (true) {
+        bool restart = false;
+        parser->parse();
+        if (const auto program = parser->getProgram()) {
+            try {
+                CompileOptions compileOptions;
+                // An edit may start calling any function, and no call may have been folded into its result
+                compileOptions.keepAllFunctions = true;
+                compileOptions.evaluatePureCalls = false;
+                Compiler compiler(compileOptions);
+                Chunk bytecode = compiler.compile(program);
+
+                HotSwap swaps;
+                {
+                    // Declared after the program it patches: its thread is joined before they go away
+                    HotReloader reloader(filePath, watcher, *parser, compiler, swaps, logger.get());
+                    VM vm;
+                    try {
+                        vm.execute(bytecode, driver.get(), logger.get(), &compiler.getFunctions(), nullptr, nullptr, &swaps);
+                    } catch (const std::exception &e) {
+                        logger->error(std::string("Execution error: ") + e.what());
+                    }
+                    restart = reloader.needsRestart();
+                }
+                // Messages of reloads after the program's last call
+                swaps.install(compiler.getFunctions(), logger.get());
+            } catch (const std::exception &e) {
+                logger->error(std::string("Execution error: ") + e.what());
+            }
+        } else {
+            logger->error("Parsing failed");
+        }
+
+        if (!restart) {
+            logger->info("Waiting for changes to " + filePath);
+            while (!watcher.wait(std::chrono::hours(1))) {}
+        }
+        // An editor may remove the file for a moment while it saves; then the next save is waited for
+        while (true) {
+            try {
+                parser = std::make_unique<Parser>(filePath, logger.get());
+                break;
+            } catch (const std::exception &e) {
+                logger->error(e.what());
+                while (!watcher.wait(std::chrono::hours(1))) {}
+            }
+        }
+    }
+}
+
+void Executor::executeStreaming() {
+    if (options.tiered) {
+        // The background compiler would read the symbol table while the parser extends it
+        logger->warn("--tiered is ignored with --stream");
+    }
+    try {
+        CompileOptions compileOptions;
+        compileOptions.lazyFunctions = options.lazyCompile;
+        Compiler compiler(compileOptions);
+        VM vm;
+        bool started = false;
+        while (ProgramNode* batch = parser->parseBatch()) {
+            Chunk bytecode = compiler.compileBatch(batch);
+            if (!started) {
+                vm.execute(bytecode, driver.get(), logger.get(), &compiler.getFunctions(),
+                           options.lazyCompile ? &compiler : nullptr);
+                started = true;
+            } else {
+                vm.resume(bytecode);
+            }
+        }
+    } catch (const std::exception &e) {
+        logger->error(std::string("Execution error: ") + e.what());
+    }
+}
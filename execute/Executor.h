@@ -7,20 +7,50 @@
 #include "../device/IDeviceDriver.h"
 
 
+/**
+ * @brief Command-line switches that change how a script is compiled and run.
+ */
+struct ExecutionOptions {
+    bool lazyCompile = false; ///< Compile function bodies on first call (--lazy)
+    bool tiered = false;      ///< Start functions unoptimized and re-optimize hot ones (--tiered)
+    bool streaming = false;   ///< Parse, compile and run the script in batches of statements (--stream)
+    bool cacheBytecode = true; ///< Reuse and write script.irisc (off with --no-cache)
+    bool writeSnapshot = false; ///< Run up to the snapshot statement and save the state to script.irisnap (--snapshot)
+    bool fromSnapshot = false;  ///< Resume from script.irisnap instead of running the script from the start (--from-snapshot)
+    bool watch = false;         ///< Reload edited functions while the script runs, and run it again after other edits (--watch)
+};
+
 class Executor {
 private:
     std::string filePath;
+    ExecutionOptions options;
     std::unique_ptr<Logger> logger;
     std::unique_ptr<IDeviceDriver> driver;
     std::unique_ptr<Parser> parser;
 
     public:
-    explicit Executor(const std::string &filePath);
+    explicit Executor(const std::string &filePath, const ExecutionOptions &options = {});
 
     void init();
 
     void execute();
 
+private:
+    /** @brief Eager mode: compiles the script, or loads it from its cache, and runs it once. */
+    void executeScript();
+
+    /** @brief --snapshot: runs the script up to its snapshot statement and saves the program and globals. */
+    void writeSnapshot();
+
+    /** @brief --from-snapshot: continues after the snapshot statement, or runs normally if the snapshot is stale. */
+    void executeFromSnapshot();
+
+    /** @brief --watch: runs the script, hot-swapping edited functions, and again whenever it changes; never returns. */
+    void executeWatching();
+
+    /** @brief Runs each batch as soon as it is compiled; memory stays bounded by the batch size. */
+    void executeStreaming();
+
 };
 
 
@@ -0,0 +1,83 @@
+#include "FileWatcher.h"
+
+#include <stdexcept>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher(const std::string& filePath) : path(std::filesystem::absolute(filePath)) {
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) throw std::runtime_error("Cannot watch " + filePath);
+    if (inotify_add_watch(fd, path.parent_path().c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(fd);
+        throw std::runtime_error("Cannot watch " + filePath);
+    }
+}
+
+FileWatcher::~FileWatcher() {
+    close(fd);
+}
+
+bool FileWatcher::drainEvents() {
+    const std::string name = path.filename().string();
+    bool changed = false;
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(fd, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t offset = 0; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->len > 0 && name == event->name) changed = true;
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+    }
+    return changed;
+}
+
+bool FileWatcher::wait(const std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    pollfd pending{fd, POLLIN, 0};
+    while (true) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0 || poll(&pending, 1, static_cast<int>(left.count())) <= 0) return false;
+        if (!drainEvents()) continue;
+        // Take in the rest of the save
+        do std::this_thread::sleep_for(SETTLE_TIME);
+        while (drainEvents());
+        return true;
+    }
+}
+
+#else
+
+FileWatcher::FileWatcher(const std::string& filePath) : path(filePath), lastWrite(writeTime()) {}
+
+FileWatcher::~FileWatcher() = default;
+
+std::filesystem::file_time_type FileWatcher::writeTime() const {
+    // Missing while an editor replaces it: the next poll sees the new file
+    std::error_code error;
+    const auto time = std::filesystem::last_write_time(path, error);
+    return error ? std::filesystem::file_time_type::min() : time;
+}
+
+bool FileWatcher::wait(const std::chrono::milliseconds timeout) {
+    constexpr std::chrono::milliseconds POLL_INTERVAL{100};
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < deadline) {
+        if (const auto time = writeTime(); time != lastWrite && time != std::filesystem::file_time_type::min()) {
+            std::this_thread::sleep_for(SETTLE_TIME);
+            lastWrite = writeTime();
+            return true;
+        }
+        std::this_thread::sleep_for(POLL_INTERVAL);
+    }
+    return false;
+}
+
+#endif
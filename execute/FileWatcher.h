@@ -0,0 +1,45 @@
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+/**
+ * @brief Reports writes to one file (--watch).
+ * On Linux it uses inotify on the file's directory, so editors that save by writing a new
+ * file and renaming it over the old one are seen as well. Elsewhere it polls the
+ * modification time.
+ */
+class FileWatcher {
+public:
+    /** @throws std::runtime_error if the directory cannot be watched. */
+    explicit FileWatcher(const std::string& filePath);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    /**
+     * @brief Waits until the file is written, or the timeout passes.
+     * A save often arrives as several writes; they are reported as one change.
+     * @return True if the file changed.
+     */
+    bool wait(std::chrono::milliseconds timeout);
+
+private:
+    /** @brief Writes closer together than this belong to the same save. */
+    static constexpr std::chrono::milliseconds SETTLE_TIME{50};
+
+    std::filesystem::path path;
+#ifdef __linux__
+    int fd = -1;
+    /** @brief Reads the queued events. @return True if one of them is about the file. */
+    bool drainEvents();
+#else
+    std::filesystem::file_time_type lastWrite;
+    std::filesystem::file_time_type writeTime() const;
+#endif
+};
+
+#endif //FILEWATCHER_H
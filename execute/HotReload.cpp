@@ -0,0 +1,102 @@
+#include "HotReload.h"
+
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+    /** @return Why body cannot stand in for the running function, or an empty string if it can. */
+    std::string incompatibility(const FunctionObject& current, const FunctionObject& body) {
+        // Callers were compiled against the signature; their purity and memo tables against the callee's
+        if (body.arity != current.arity || body.paramTypes != current.paramTypes || body.returnType != current.returnType)
+            return "its signature changed";
+        if (body.memoize != current.memoize) return "@memo was added or removed";
+        if (current.pure && !body.pure) return "it has side effects now";
+        return {};
+    }
+}
+
+HotReloader::HotReloader(const std::string& filePath, FileWatcher& watcher, Parser& parser, const Compiler& compiler,
+                         HotSwap& swaps, Logger* logger)
+    : filePath(filePath), watcher(watcher), compiler(compiler), functions(compiler.getFunctions()), swaps(swaps),
+      logger(logger), symbols(parser.getProgram()->symbols) {
+    const Parser::Outline outline = parser.outline();
+    restHash = outline.restHash;
+
+    std::unordered_map<const FunctionDeclNode*, uint16_t> byDecl;
+    for (const FunctionObject& func : functions) byDecl.emplace(func.decl, func.index);
+    for (ASTNode* stmt : parser.getProgram()->statements) {
+        if (stmt->getType() != StmtType::FunctionDecl) continue;
+        const auto it = byDecl.find(static_cast<FunctionDeclNode*>(stmt));
+        if (it == byDecl.end()) break;
+        indices.push_back(it->second);
+    }
+    for (const Parser::FunctionSpan& span : outline.functions) hashes.push_back(span.hash);
+    // Declarations the outline and the parser see differently are never patched
+    if (indices.size() != hashes.size()) hashes.clear();
+
+    thread = std::thread(&HotReloader::watchLoop, this);
+}
+
+HotReloader::~HotReloader() {
+    stopping.store(true, std::memory_order_relaxed);
+    thread.join();
+}
+
+void HotReloader::watchLoop() {
+    constexpr std::chrono::milliseconds STOP_CHECK_INTERVAL{100};
+    while (!stopping.load(std::memory_order_relaxed) && !needsRestart()) {
+        if (watcher.wait(STOP_CHECK_INTERVAL)) reload();
+    }
+}
+
+void HotReloader::reload() {
+    std::unique_ptr<Parser> parser;
+    Parser::Outline outline;
+    try {
+        parser = std::make_unique<Parser>(filePath, logger, symbols);
+        outline = parser->outline();
+    } catch (const std::exception& e) {
+        swaps.report(LogType::ERROR, std::string("Reload failed: ") + e.what());
+        return;
+    }
+    if (outline.restHash != restHash || outline.functions.size() != hashes.size()) {
+        requestRestart("code outside function bodies changed");
+        return;
+    }
+
+    std::vector<HotSwap::Replacement> replacements;
+    std::vector<size_t> changed;
+    for (size_t i = 0; i < outline.functions.size(); i++) {
+        if (outline.functions[i].hash == hashes[i]) continue;
+        const FunctionObject& current = functions[indices[i]];
+        try {
+            FunctionDeclNode* decl = parser->parseFunction(outline.functions[i]);
+            auto body = compiler.fork()->compileReplacement(decl, current, functions);
+            if (const std::string reason = incompatibility(current, *body); !reason.empty()) {
+                requestRestart("'" + current.name + "' cannot be replaced: " + reason);
+                return;
+            }
+            replacements.push_back({indices[i], std::move(body)});
+            changed.push_back(i);
+        } catch (const std::exception& e) {
+            // Edited functions may rely on each other, so none is installed
+            swaps.report(LogType::ERROR, std::string("Reload failed: ") + e.what());
+            return;
+        }
+    }
+    if (replacements.empty()) return;
+
+    std::string names;
+    for (const size_t i : changed) {
+        hashes[i] = outline.functions[i].hash;
+        names += (names.empty() ? "" : ", ") + functions[indices[i]].name;
+    }
+    swaps.post(std::move(replacements));
+    sources.push_back(std::move(parser));
+    swaps.report(LogType::INFO, "Reloaded " + names);
+}
+
+void HotReloader::requestRestart(const std::string& reason) {
+    swaps.report(LogType::WARN, "Cannot reload " + filePath + " while it runs (" + reason + "); it runs again when this run ends");
+    restart.store(true, std::memory_order_release);
+}
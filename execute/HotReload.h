@@ -0,0 +1,72 @@
+#ifndef HOTRELOAD_H
+#define HOTRELOAD_H
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileWatcher.h"
+#include "../bytecode/Compiler.h"
+#include "../bytecode/HotSwap.h"
+#include "../log/Logger.h"
+#include "../parser/Parser.h"
+
+/**
+ * @brief --watch: recompiles the functions edited while a script runs and hands them to the VM.
+ * A thread waits for the script to be saved, lexes it again and compares each top-level
+ * function declaration with the running one by the hash of its tokens. Only declarations
+ * that differ are parsed and compiled, on forks of the program's compiler, so their names
+ * resolve to the running program's functions and globals. The VM installs them at its next
+ * call (HotSwap); globals keep their values.
+ *
+ * A change anywhere else (top-level statements, functions added, removed or renamed, a new
+ * signature, lost purity, @memo) cannot be patched into the running code; it is reported
+ * and needsRestart() becomes true. Messages go through the HotSwap, as the VM thread owns
+ * the output. The reload parsers extend the program's symbol table, which only this
+ * thread touches once the program is compiled.
+ */
+class HotReloader {
+public:
+    /**
+     * @param parser Parser of the running program, after parse().
+     * @param compiler Compiler of the running program, created with keepAllFunctions so that
+     * every declaration has a function, and without evaluatePureCalls so that no call was
+     * replaced by its result.
+     */
+    HotReloader(const std::string& filePath, FileWatcher& watcher, Parser& parser, const Compiler& compiler,
+                HotSwap& swaps, Logger* logger);
+    ~HotReloader();
+
+    HotReloader(const HotReloader&) = delete;
+    HotReloader& operator=(const HotReloader&) = delete;
+
+    /** @brief Whether the script was changed in a way that needs it to run again. */
+    [[nodiscard]] bool needsRestart() const { return restart.load(std::memory_order_acquire); }
+
+private:
+    std::string filePath;
+    FileWatcher& watcher;
+    const Compiler& compiler;
+    const std::deque<FunctionObject>& functions;
+    HotSwap& swaps;
+    Logger* logger; ///< For the reload parsers; reports go through swaps
+    std::shared_ptr<SymbolTable> symbols;
+
+    uint64_t restHash;
+    std::vector<uint64_t> hashes;   ///< Per top-level declaration, of the version running
+    std::vector<uint16_t> indices;  ///< Function of each top-level declaration
+    std::vector<std::unique_ptr<Parser>> sources; ///< ASTs of installed bodies
+
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> restart{false};
+    std::thread thread;
+
+    void watchLoop();
+    void reload();
+    void requestRestart(const std::string& reason);
+};
+
+#endif //HOTRELOAD_H
@@ -0,0 +1,218 @@
+#include "ModuleLoader.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include "../bytecode/BytecodeCache.h"
+#include "../parser/Parser.h"
+
+namespace {
+    bool isGlobalAccess(const uint32_t instr) {
+        const OpCode op = DECODE_OP(instr);
+        return op == OpCode::OP_GGLOB || op == OpCode::OP_SGLOB || op == OpCode::OP_DGLOB;
+    }
+
+    /** @brief Number of global slots a chunk uses; every unit numbers its globals from 0. */
+    uint32_t globalSlots(const Chunk& chunk) {
+        uint32_t slots = 0;
+        for (const uint32_t instr : chunk.instructions()) {
+            if (isGlobalAccess(instr)) slots = std::max<uint32_t>(slots, DECODE_Bx(instr) + 1u);
+        }
+        return slots;
+    }
+
+    /** @brief Moves the chunk's globals to start at base; code in a mapped image is copied first. */
+    void relocateGlobals(Chunk& chunk, const uint32_t base) {
+        const auto instructions = chunk.instructions();
+        if (base == 0 || std::ranges::none_of(instructions, isGlobalAccess)) return;
+        std::vector<uint32_t> code(instructions.begin(), instructions.end());
+        for (uint32_t& instr : code) {
+            if (isGlobalAccess(instr)) {
+                instr = encodeABx(DECODE_OP(instr), DECODE_A(instr), static_cast<uint16_t>(DECODE_Bx(instr) + base));
+            }
+        }
+        chunk.code = std::move(code);
+        chunk.image = {};
+    }
+
+    /** @brief Identity of a file, so one module imported along two paths is loaded once. */
+    std::string unitKey(const std::string& path) {
+        if (path == SourceFile::STDIN_PATH) return path;
+        std::error_code error;
+        const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        return error ? std::filesystem::path(path).lexically_normal().string() : canonical.string();
+    }
+}
+
+ModuleLoader::ModuleLoader(Logger* logger, const bool cacheBytecode, const bool allFunctions)
+    : logger(logger), cacheBytecode(cacheBytecode), allFunctions(allFunctions) {}
+
+std::optional<ModuleLoader::Program> ModuleLoader::load(Parser& parser, const std::string& filePath) {
+    if (!loadUnit(parser, filePath, true)) return std::nullopt;
+    return link();
+}
+
+std::optional<size_t> ModuleLoader::loadUnit(Parser& parser, const std::string& path, const bool root) {
+    // Another program may call any function of a module
+    const bool keepAll = !root || allFunctions;
+    Unit unit;
+    unit.path = unitKey(path);
+    loading.push_back(unit.path);
+
+    bool cached = false;
+    std::unique_ptr<BytecodeCache> cache;
+    if (cacheBytecode && path != SourceFile::STDIN_PATH) {
+        cache = std::make_unique<BytecodeCache>(path, parser.getSource(), keepAll);
+        if (auto program = cache->load()) {
+            std::vector<size_t> imports = loadImports(unit.path, program->imports);
+            // A module may have dropped or changed a function this one calls
+            if (importsMatch(program->functions, imports)) {
+                unit.mapping = std::move(program->mapping);
+                unit.main = std::move(program->main);
+                unit.functions = std::move(program->functions);
+                unit.importPaths = std::move(program->imports);
+                unit.imports = std::move(imports);
+                cached = true;
+            }
+        }
+    }
+
+    if (!cached) {
+        parser.parse();
+        ProgramNode* program = parser.getProgram();
+        if (!program) {
+            if (root) return std::nullopt;
+            throw std::runtime_error("Parsing failed: " + path);
+        }
+        for (ASTNode* stmt : program->statements) {
+            if (stmt->getType() == StmtType::Import) unit.importPaths.emplace_back(static_cast<ImportNode*>(stmt)->path);
+        }
+        unit.imports = loadImports(unit.path, unit.importPaths);
+
+        CompileOptions options;
+        options.keepAllFunctions = keepAll;
+        options.resolvesImports = true;
+        Compiler compiler(options);
+        for (size_t i = 0; i < unit.imports.size(); i++) {
+            // The same module imported twice provides its functions once
+            if (std::find(unit.imports.begin(), unit.imports.begin() + i, unit.imports[i]) != unit.imports.begin() + i) continue;
+            const Unit& module = units[unit.imports[i]];
+            for (const auto& func : module.functions) {
+                if (func.importedFrom >= 0 || module.exports.at(func.name) != func.index) continue;
+                // A name the program never spells cannot be called
+                const Symbol name = program->symbols->find(func.name);
+                if (name != NO_SYMBOL) compiler.importFunction(name, func, static_cast<int>(i));
+            }
+        }
+        unit.main = compiler.compile(program);
+        if (cache) cache->store(unit.main, compiler.getFunctions(), unit.importPaths);
+        unit.functions = std::move(compiler.getFunctions());
+        // The AST goes away with the parser; only tier-up would look at it
+        unit.main.loopHeaders.clear();
+        for (FunctionObject& func : unit.functions) {
+            func.decl = nullptr;
+            func.chunk.loopHeaders.clear();
+        }
+    }
+
+    for (const FunctionObject& func : unit.functions) {
+        if (func.importedFrom < 0) unit.exports.try_emplace(func.name, func.index);
+    }
+    loading.pop_back();
+    unitIndex[unit.path] = units.size();
+    units.push_back(std::move(unit));
+    return units.size() - 1;
+}
+
+std::vector<size_t> ModuleLoader::loadImports(const std::string& path, const std::vector<std::string>& importPaths) {
+    namespace fs = std::filesystem;
+    const fs::path directory = path == SourceFile::STDIN_PATH ? fs::path() : fs::path(path).parent_path();
+    std::vector<size_t> imports;
+    imports.reserve(importPaths.size());
+    for (const std::string& importPath : importPaths) {
+        const std::string modulePath = unitKey((directory / importPath).string());
+        if (const auto it = unitIndex.find(modulePath); it != unitIndex.end()) {
+            imports.push_back(it->second);
+            continue;
+        }
+        if (const auto it = std::ranges::find(loading, modulePath); it != loading.end()) {
+            std::string cycle;
+            for (auto step = it; step != loading.end(); ++step) cycle += *step + " -> ";
+            throw std::runtime_error("Import cycle: " + cycle + modulePath);
+        }
+        Parser parser(modulePath, logger);
+        imports.push_back(*loadUnit(parser, modulePath, false));
+    }
+    return imports;
+}
+
+bool ModuleLoader::importsMatch(const std::deque<FunctionObject>& functions, const std::vector<size_t>& imports) const {
+    for (const FunctionObject& func : functions) {
+        if (func.importedFrom < 0) continue;
+        const Unit& module = units[imports[func.importedFrom]];
+        const auto it = module.exports.find(func.name);
+        if (it == module.exports.end()) return false;
+        const FunctionObject& exported = module.functions[it->second];
+        // Calls were compiled against the signature and purity
+        if (exported.arity != func.arity || exported.paramTypes != func.paramTypes ||
+            exported.returnType != func.returnType || exported.pure != func.pure) return false;
+    }
+    return true;
+}
+
+ModuleLoader::Program ModuleLoader::link() {
+    // The script first: its globals keep their slots, so its code runs as compiled
+    std::vector<size_t> layout{units.size() - 1};
+    for (size_t u = 0; u + 1 < units.size(); u++) layout.push_back(u);
+
+    std::vector<std::vector<uint16_t>> finalIndex(units.size());
+    std::vector<uint32_t> globalBase(units.size());
+    size_t functionCount = 0;
+    uint32_t globalCount = 0;
+    for (const size_t u : layout) {
+        const Unit& unit = units[u];
+        finalIndex[u].resize(unit.functions.size());
+        uint32_t slots = globalSlots(unit.main);
+        for (const FunctionObject& func : unit.functions) {
+            if (func.importedFrom >= 0) continue;
+            if (functionCount > UINT16_MAX) throw std::runtime_error("Too many functions");
+            finalIndex[u][func.index] = static_cast<uint16_t>(functionCount++);
+            slots = std::max(slots, globalSlots(func.chunk));
+        }
+        globalBase[u] = globalCount;
+        globalCount += slots;
+    }
+    // Global slots are 16-bit operands
+    if (globalCount > UINT16_MAX + 1u) throw std::runtime_error("Too many globals");
+
+    // An imported function is called at the index its module's copy ends up with
+    for (size_t u = 0; u < units.size(); u++) {
+        for (const FunctionObject& func : units[u].functions) {
+            if (func.importedFrom < 0) continue;
+            const size_t module = units[u].imports[func.importedFrom];
+            finalIndex[u][func.index] = finalIndex[module][units[module].exports.at(func.name)];
+        }
+    }
+
+    const auto relocate = [&](const size_t u, Chunk& chunk) {
+        for (CallSite& site : chunk.callSites) site.funcIdx = finalIndex[u][site.funcIdx];
+        relocateGlobals(chunk, globalBase[u]);
+    };
+    Program program;
+    for (const size_t u : layout) {
+        for (FunctionObject& func : units[u].functions) {
+            if (func.importedFrom >= 0) continue;
+            relocate(u, func.chunk);
+            func.index = finalIndex[u][func.index];
+            program.functions.push_back(std::move(func));
+        }
+    }
+    for (size_t u = 0; u < units.size(); u++) {
+        relocate(u, units[u].main);
+        program.mains.push_back(std::move(units[u].main));
+        if (units[u].mapping) program.mappings.push_back(std::move(units[u].mapping));
+    }
+    units.clear();
+    unitIndex.clear();
+    return program;
+}
@@ -0,0 +1,75 @@
+#ifndef MODULELOADER_H
+#define MODULELOADER_H
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "../bytecode/Chunk.h"
+#include "../bytecode/Compiler.h"
+#include "../log/Logger.h"
+#include "../parser/SourceFile.h"
+
+class Parser;
+
+/**
+ * @brief Loads a script and the modules it imports, and links them into one program.
+ * Every file is a unit of its own: compiled on its own, or loaded from its .irisc cache
+ * if the file is unchanged. A unit calls imported functions through entries that hold
+ * only their signature (FunctionObject::importedFrom), so editing a module's function
+ * bodies recompiles that module alone. Linking lays the units' functions out in one
+ * table and their globals side by side: call sites are pointed at the final function
+ * indices, and the global slots of every unit but the script are shifted by its base.
+ */
+class ModuleLoader {
+public:
+    /** @brief A linked program. */
+    struct Program {
+        std::vector<std::shared_ptr<const SourceFile>> mappings; ///< Bytecode images the code points into
+        std::vector<Chunk> mains; ///< Top-level code per unit in run order: imports first, the script last
+        std::deque<FunctionObject> functions;
+    };
+
+    /**
+     * @param cacheBytecode Reuse and write the .irisc file of every unit.
+     * @param allFunctions Keep functions the script never calls (modules always keep all).
+     */
+    ModuleLoader(Logger* logger, bool cacheBytecode, bool allFunctions);
+
+    /**
+     * @brief Loads the script opened by parser and everything it imports.
+     * @return nullopt if the script failed to parse; the parser has logged why.
+     * @throws std::runtime_error if a module cannot be read, parsed or compiled, or imports form a cycle.
+     */
+    std::optional<Program> load(Parser& parser, const std::string& filePath);
+
+private:
+    struct Unit {
+        std::string path;
+        std::shared_ptr<const SourceFile> mapping;
+        Chunk main;
+        std::deque<FunctionObject> functions; ///< Own functions and entries for imported ones
+        std::vector<std::string> importPaths; ///< As written in the import statements
+        std::vector<size_t> imports;          ///< Unit of each import statement
+        std::unordered_map<std::string, uint16_t> exports; ///< Own functions by name
+    };
+
+    Logger* logger;
+    bool cacheBytecode;
+    bool allFunctions;
+    std::deque<Unit> units; ///< Dependencies before the units that import them
+    std::unordered_map<std::string, size_t> unitIndex;
+    std::vector<std::string> loading; ///< Units being loaded, for cycle detection
+
+    /** @return Index of the unit, or nullopt if the root script failed to parse. */
+    std::optional<size_t> loadUnit(Parser& parser, const std::string& path, bool root);
+    /** @brief Loads the units a unit imports; paths are relative to the unit's directory. */
+    std::vector<size_t> loadImports(const std::string& path, const std::vector<std::string>& importPaths);
+    /** @brief Whether every imported function a cached unit calls still exists with the same purity. */
+    bool importsMatch(const std::deque<FunctionObject>& functions, const std::vector<size_t>& imports) const;
+    Program link();
+};
+
+#endif //MODULELOADER_H
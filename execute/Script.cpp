@@ -0,0 +1,79 @@
+#include "Script.h"
+
+#include <stdexcept>
+#include "ModuleLoader.h"
+#include "../parser/Parser.h"
+
+std::shared_ptr<const Script> Script::compile(const std::string& filePath, const ScriptOptions& options) {
+    Logger logger;
+    Parser parser(filePath, &logger);
+    auto script = compile(parser, filePath, options);
+    if (!script) throw std::runtime_error("Parsing failed");
+    return script;
+}
+
+std::shared_ptr<const Script> Script::compile(Parser& parser, const std::string& filePath,
+                                              const ScriptOptions& options) {
+    auto script = std::shared_ptr<Script>(new Script);
+    Logger logger;
+    ModuleLoader loader(&logger, options.cacheBytecode, options.allFunctions);
+    auto program = loader.load(parser, filePath);
+    if (!program) return nullptr;
+    script->mappings = std::move(program->mappings);
+    script->mains = std::move(program->mains);
+    script->functions = std::move(program->functions);
+    script->indexFunctions();
+    return script;
+}
+
+void Script::indexFunctions() {
+    for (size_t i = 0; i < functions.size(); i++) {
+        // Dropped by the compiler: the program never calls it, so it has no code to run
+        if (functions[i].dead) continue;
+        functionIndex.try_emplace(functions[i].name, static_cast<uint16_t>(i));
+    }
+}
+
+std::optional<uint16_t> Script::findFunction(const std::string_view name) const {
+    const auto it = functionIndex.find(std::string(name));
+    if (it == functionIndex.end()) return std::nullopt;
+    return it->second;
+}
+
+ScriptInstance::ScriptInstance(std::shared_ptr<const Script> script, IDeviceDriver* driver, Logger* logger)
+    : script(std::move(script)), driver(driver), logger(logger), vm(std::make_unique<VM>()) {
+    for (const Chunk& main : this->script->mains) mains.push_back(main.share());
+    // Call sites and specializations are written while running, so each instance gets its own table
+    for (const FunctionObject& func : this->script->functions) {
+        FunctionObject& copy = functions.emplace_back();
+        copy.name = func.name;
+        copy.arity = func.arity;
+        copy.chunk = func.chunk.share();
+        copy.maxRegs = func.maxRegs;
+        copy.returnType = func.returnType;
+        copy.paramTypes = func.paramTypes;
+        copy.compiled = func.compiled;
+        copy.pure = func.pure;
+        copy.memoize = func.memoize;
+        copy.specializable = func.specializable;
+        copy.index = func.index;
+    }
+    vm->attach(driver, logger);
+}
+
+void ScriptInstance::run() {
+    // Imported modules first, each on the globals the previous ones defined
+    vm->execute(mains.front(), driver, logger, &functions);
+    for (size_t i = 1; i < mains.size(); i++) vm->resume(mains[i]);
+}
+
+Value ScriptInstance::call(const std::string_view name, const std::vector<Value>& args) {
+    const auto function = script->findFunction(name);
+    if (!function) throw std::runtime_error("Undefined function: " + std::string(name));
+    return call(*function, args);
+}
+
+Value ScriptInstance::call(const uint16_t function, const std::vector<Value>& args) {
+    if (function >= functions.size()) throw std::runtime_error("Invalid function index");
+    return vm->invoke(functions, function, args);
+}
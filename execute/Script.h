@@ -0,0 +1,100 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "../bytecode/Chunk.h"
+#include "../bytecode/Compiler.h"
+#include "../bytecode/VM.h"
+#include "../device/IDeviceDriver.h"
+#include "../log/Logger.h"
+#include "../parser/SourceFile.h"
+
+class Parser;
+
+/**
+ * @brief Switches for Script::compile().
+ */
+struct ScriptOptions {
+    bool cacheBytecode = true; ///< Reuse and write script.irisc, as the command line does
+    bool allFunctions = true;  ///< Compile functions the script never calls, so call() can reach them
+};
+
+/**
+ * @brief A script compiled once, to be run any number of times.
+ * Immutable after compile(), so one Script can back many ScriptInstances on different
+ * threads at once. Functions are always compiled eagerly: lazy and tiered compilation
+ * need the AST, which is released once compile() returns. Imported modules are linked
+ * in (see ModuleLoader), so call() reaches their functions too.
+ */
+class Script {
+    std::vector<std::shared_ptr<const SourceFile>> mappings; ///< Bytecode images the code points into, for cached units
+    std::vector<Chunk> mains; ///< Top-level code of the imported modules, then of the script
+    std::deque<FunctionObject> functions;
+    std::unordered_map<std::string, uint16_t> functionIndex; ///< First function of each name
+
+    friend class ScriptInstance;
+
+    Script() = default;
+    void indexFunctions();
+
+public:
+    /**
+     * @brief Parses and compiles a script file and its imports, or loads them from their bytecode caches.
+     * @throws std::runtime_error if a file cannot be read, parsed or compiled.
+     */
+    static std::shared_ptr<const Script> compile(const std::string& filePath, const ScriptOptions& options = {});
+
+    /**
+     * @brief Same, with a parser already opened on filePath.
+     * @return nullptr if parsing failed; the parser has logged why.
+     * @throws std::runtime_error if the program or a module cannot be compiled.
+     */
+    static std::shared_ptr<const Script> compile(Parser& parser, const std::string& filePath,
+                                                 const ScriptOptions& options = {});
+
+    /** @return Index of the function for ScriptInstance::call(), or nullopt if there is none. */
+    [[nodiscard]] std::optional<uint16_t> findFunction(std::string_view name) const;
+};
+
+/**
+ * @brief One run of a Script on a VM of its own.
+ * Globals, inline caches, specialized clones and memo tables belong to the instance;
+ * the code and constants are shared with the Script. An instance is used by one thread
+ * at a time, while separate instances of one Script may run concurrently.
+ */
+class ScriptInstance {
+    std::shared_ptr<const Script> script;
+    IDeviceDriver* driver;
+    Logger* logger;
+    std::vector<Chunk> mains;
+    std::deque<FunctionObject> functions;
+    std::unique_ptr<VM> vm; ///< On the heap: the register stack is large
+
+public:
+    /** @param driver Device for mouse, keyboard and wait statements; must outlive the instance. */
+    ScriptInstance(std::shared_ptr<const Script> script, IDeviceDriver* driver, Logger* logger);
+
+    /**
+     * @brief Runs the top-level statements of the imports, then of the script, starting from fresh globals.
+     * @throws std::runtime_error on a runtime error in the script.
+     */
+    void run();
+
+    /**
+     * @brief Calls a function of the script. Globals defined by a previous run() are visible to it.
+     * @throws std::runtime_error if there is no such function, the argument count is wrong,
+     * or the call fails.
+     */
+    Value call(std::string_view name, const std::vector<Value>& args = {});
+
+    /** @brief Same, by an index from Script::findFunction(). */
+    Value call(uint16_t function, const std::vector<Value>& args = {});
+};
+
+#endif //SCRIPT_H
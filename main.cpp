@@ -25,10 +25,20 @@ void setupConsole() {
 
 int main(const int argc, char* argv[]) {
     std::string filePath;
-
-    if (argc >= 2) {
-        filePath = argv[1];
-    } else {
+    ExecutionOptions options;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--lazy") options.lazyCompile = true;
+        else if (arg == "--tiered") options.tiered = true;
+        else if (arg == "--stream") options.streaming = true;
+        else if (arg == "--no-cache") options.cacheBytecode = false;
+        else if (arg == "--snapshot") options.writeSnapshot = true;
+        else if (arg == "--from-snapshot") options.fromSnapshot = true;
+        else if (arg == "--watch") options.watch = true;
+        else filePath = arg;
+    }
+    if (filePath.empty()) {
         filePath = R"(C:\Users\chalo\CLionProjects\IRIS\main.iris)";
         //std::cout << "Debug info: No arguments provided. Using default file: " << filePath << std::endl;
     }
@@ -39,7 +49,7 @@ int main(const int argc, char* argv[]) {
 
     const auto start = std::chrono::high_resolution_clock::now();
     try {
-        auto executor = Executor(filePath);
+        auto executor = Executor(filePath, options);
         executor.execute();
     } catch (const std::exception& e) {
         std::cerr << "CRITICAL ERROR: " << e.what() << std::endl;
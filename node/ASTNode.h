@@ -3,9 +3,10 @@
 #define LTSNODE_H
 #include <memory>
 #include <optional>
+#include <span>
+#include <string_view>
 #include <utility>
-#include <vector>
-#include <string>
+#include "../core/Symbol.h"
 
 /**
  * @brief Optional type annotation for variables and function parameters.
@@ -41,7 +42,7 @@ inline const char* typeAnnotationName(TypeAnnotation t) {
 enum class StmtType {
     Program, Repeat, While, For, Print, VarDecl, Assignment,
     Wait, MouseBlock, Click, Move, Shift, KeyboardBlock,
-    Write, Press, If, Break, Continue, FunctionDecl, Return
+    Write, Press, If, Break, Continue, FunctionDecl, Return, Snapshot, Import
 };
 
 enum class ExprType {
@@ -50,18 +51,29 @@ enum class ExprType {
 };
 
 
+/*
+ * Nodes live in the Parser's Arena and are released together with it, never one by one:
+ * children are plain pointers, lists are spans over arena arrays, and every node type
+ * is trivially destructible (the destructors below are protected and non-virtual).
+ */
 class ASTNode {
 public:
-    virtual ~ASTNode() = default;
     [[nodiscard]] virtual StmtType getType() const = 0;
+protected:
+    ~ASTNode() = default;
 };
 
 class ExpressionNode {
 public:
-    virtual ~ExpressionNode() = default;
     [[nodiscard]] virtual ExprType getType() const = 0;
+protected:
+    ~ExpressionNode() = default;
 };
 
+using NodeList = std::span<ASTNode* const>;
+using ExprList = std::span<ExpressionNode* const>;
+using ParamList = std::span<const std::pair<Symbol, TypeAnnotation>>;
+
 
 class NumberNode : public ExpressionNode {
 public:
@@ -86,121 +98,123 @@ public:
 
 class VariableNode : public ExpressionNode {
 public:
-    std::string nameOfVariable;
-    explicit VariableNode(std::string name) : nameOfVariable(std::move(name)) {}
+    Symbol nameOfVariable;
+    explicit VariableNode(const Symbol name) : nameOfVariable(name) {}
     [[nodiscard]] ExprType getType() const override { return ExprType::Variable; }
 };
 
 class StringNode : public ExpressionNode {
 public:
-    std::string value;
-    explicit StringNode(std::string value) : value(std::move(value)) {}
+    std::string_view value; ///< Characters owned by the arena
+    explicit StringNode(const std::string_view value) : value(value) {}
     [[nodiscard]] ExprType getType() const override { return ExprType::String; }
 };
 
 class BinaryOperationNode : public ExpressionNode {
 public:
-    std::unique_ptr<ExpressionNode> leftNode;
-    std::unique_ptr<ExpressionNode> rightNode;
-    std::string operation{};
-    explicit BinaryOperationNode(std::unique_ptr<ExpressionNode> leftNode,
-        std::unique_ptr<ExpressionNode> rightNode, std::string operation) :
-    leftNode(std::move(leftNode)), rightNode(std::move(rightNode)), operation(std::move(operation)) {}
+    ExpressionNode* leftNode;
+    ExpressionNode* rightNode;
+    Symbol operation;
+    explicit BinaryOperationNode(ExpressionNode* leftNode,
+        ExpressionNode* rightNode, const Symbol operation) :
+    leftNode(leftNode), rightNode(rightNode), operation(operation) {}
     [[nodiscard]] ExprType getType() const override { return ExprType::BinaryOp; }
 };
 
 class UnaryOperationNode : public ExpressionNode {
 public:
-    std::unique_ptr<ExpressionNode> operand;
-    std::string operation;
-    UnaryOperationNode(std::string op, std::unique_ptr<ExpressionNode> operand)
-        : operand(std::move(operand)), operation(std::move(op)) {}
+    ExpressionNode* operand;
+    Symbol operation;
+    UnaryOperationNode(const Symbol op, ExpressionNode* operand)
+        : operand(operand), operation(op) {}
     [[nodiscard]] ExprType getType() const override { return ExprType::UnaryOp; }
 };
 
 class FunctionCallNode : public ExpressionNode {
 public:
-    std::string name;
-    std::vector<std::unique_ptr<ExpressionNode>> args;
-    FunctionCallNode(std::string name, std::vector<std::unique_ptr<ExpressionNode>> args)
-        : name(std::move(name)), args(std::move(args)) {}
+    Symbol name;
+    ExprList args;
+    FunctionCallNode(const Symbol name, ExprList args)
+        : name(name), args(args) {}
     [[nodiscard]] ExprType getType() const override { return ExprType::FunctionCall; }
 };
 
 
-class ProgramNode : public ASTNode {
+/** @brief Root of the tree; owned by the Parser itself, its statements by the Parser's Arena. */
+class ProgramNode final : public ASTNode {
 public:
-    std::vector<std::unique_ptr<ASTNode>> statements;
+    NodeList statements;
+    std::shared_ptr<SymbolTable> symbols; ///< Spellings of the Symbols used in the tree
     [[nodiscard]] StmtType getType() const override { return StmtType::Program; }
 };
 
 class RepeatNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> count;
-    std::vector<std::unique_ptr<ASTNode>> body;
-    explicit RepeatNode(std::unique_ptr<ExpressionNode> count, std::vector<std::unique_ptr<ASTNode>> body) : count(std::move(count)), body(std::move(body)) {}
+    ExpressionNode* count;
+    NodeList body;
+    explicit RepeatNode(ExpressionNode* count, NodeList body) : count(count), body(body) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Repeat; }
 };
 
 class WhileNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> condition;
-    std::vector<std::unique_ptr<ASTNode>> body;
-    explicit WhileNode(std::unique_ptr<ExpressionNode> condition, std::vector<std::unique_ptr<ASTNode>> body) : condition(std::move(condition)), body(std::move(body)) {}
+    ExpressionNode* condition;
+    NodeList body;
+    explicit WhileNode(ExpressionNode* condition, NodeList body) : condition(condition), body(body) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::While; }
 };
 
 class ForNode : public ASTNode {
 public:
-    std::unique_ptr<ASTNode> init;
-    std::unique_ptr<ExpressionNode> condition;
-    std::unique_ptr<ASTNode> increment;
-    std::vector<std::unique_ptr<ASTNode>> body;
-    ForNode(std::unique_ptr<ASTNode> init, std::unique_ptr<ExpressionNode> cond,
-            std::unique_ptr<ASTNode> incr, std::vector<std::unique_ptr<ASTNode>> body)
-        : init(std::move(init)), condition(std::move(cond)),
-          increment(std::move(incr)), body(std::move(body)) {}
+    ASTNode* init;
+    ExpressionNode* condition;
+    ASTNode* increment;
+    NodeList body;
+    ForNode(ASTNode* init, ExpressionNode* cond,
+            ASTNode* incr, NodeList body)
+        : init(init), condition(cond),
+          increment(incr), body(body) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::For; }
 };
 
 class PrintNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> msg;
-    explicit PrintNode(std::unique_ptr<ExpressionNode> msg) : msg(std::move(msg)) {}
+    ExpressionNode* msg;
+    explicit PrintNode(ExpressionNode* msg) : msg(msg) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Print; }
 };
 
 class VarDeclNode : public ASTNode {
 public:
-    std::string nameOfVariable;
-    std::unique_ptr<ExpressionNode> expression;
+    Symbol nameOfVariable;
+    ExpressionNode* expression;
     bool isMutable;
     TypeAnnotation typeAnnotation = TypeAnnotation::None;
-    explicit VarDeclNode(std::string name, std::unique_ptr<ExpressionNode> expr, const bool isMutable,
+    explicit VarDeclNode(const Symbol name, ExpressionNode* expr, const bool isMutable,
                          TypeAnnotation typeAnnot = TypeAnnotation::None)
-        : nameOfVariable(std::move(name)), expression(std::move(expr)),
+        : nameOfVariable(name), expression(expr),
           isMutable(isMutable), typeAnnotation(typeAnnot) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::VarDecl; }
 };
 
 class AssignmentNode : public ASTNode {
 public:
-    std::string nameOfVariable;
-    std::unique_ptr<ExpressionNode> expression;
-    AssignmentNode(std::string name, std::unique_ptr<ExpressionNode> expr) : nameOfVariable(std::move(name)), expression(std::move(expr)) {}
+    Symbol nameOfVariable;
+    ExpressionNode* expression;
+    AssignmentNode(const Symbol name, ExpressionNode* expr) : nameOfVariable(name), expression(expr) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Assignment; }
 };
 
 class WaitNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> duration;
-    explicit WaitNode(std::unique_ptr<ExpressionNode> duration) : duration(std::move(duration)) {}
+    ExpressionNode* duration;
+    explicit WaitNode(ExpressionNode* duration) : duration(duration) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Wait; }
 };
 
 class MouseBlockNode : public ASTNode {
 public:
-    std::vector<std::unique_ptr<ASTNode>> actions;
+    NodeList actions;
     [[nodiscard]] StmtType getType() const override { return StmtType::MouseBlock; }
 };
 
@@ -218,49 +232,49 @@ public:
 
 class MoveNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> x;
-    std::unique_ptr<ExpressionNode> y;
-    MoveNode(std::unique_ptr<ExpressionNode> px,
-        std::unique_ptr<ExpressionNode> py) : x(std::move(px)), y(std::move(py)){}
+    ExpressionNode* x;
+    ExpressionNode* y;
+    MoveNode(ExpressionNode* px,
+        ExpressionNode* py) : x(px), y(py){}
     [[nodiscard]] StmtType getType() const override { return StmtType::Move; }
 };
 
 class ShiftNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> deltaX;
-    std::unique_ptr<ExpressionNode> deltaY;
-    ShiftNode(std::unique_ptr<ExpressionNode> dx,
-        std::unique_ptr<ExpressionNode> dy): deltaX(std::move(dx)), deltaY(std::move(dy)) {}
+    ExpressionNode* deltaX;
+    ExpressionNode* deltaY;
+    ShiftNode(ExpressionNode* dx,
+        ExpressionNode* dy): deltaX(dx), deltaY(dy) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Shift; }
 };
 
 class KeyboardBlockNode : public ASTNode {
 public:
-    std::vector<std::unique_ptr<ASTNode>> actions;
+    NodeList actions;
     [[nodiscard]] StmtType getType() const override { return StmtType::KeyboardBlock; }
 };
 
 class WriteNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> text;
-    explicit WriteNode(std::unique_ptr<ExpressionNode> text) : text(std::move(text)) {}
+    ExpressionNode* text;
+    explicit WriteNode(ExpressionNode* text) : text(text) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Write; }
 };
 
 class PressNode : public ASTNode {
 public:
-    std::string key;
-    explicit PressNode(std::string  k) : key(std::move(k)) {}
+    std::string_view key; ///< Characters owned by the arena
+    explicit PressNode(const std::string_view k) : key(k) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Press; }
 };
 
 class IfNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> condition;
-    std::vector<std::unique_ptr<ASTNode>> thenBlock;
-    std::vector<std::unique_ptr<ASTNode>> elseBlock;
-    IfNode(std::unique_ptr<ExpressionNode> condition, std::vector<std::unique_ptr<ASTNode>> thenBlock, std::vector<std::unique_ptr<ASTNode>> elseBlock)
-        : condition(std::move(condition)), thenBlock(std::move(thenBlock)), elseBlock(std::move(elseBlock)) {}
+    ExpressionNode* condition;
+    NodeList thenBlock;
+    NodeList elseBlock;
+    IfNode(ExpressionNode* condition, NodeList thenBlock, NodeList elseBlock)
+        : condition(condition), thenBlock(thenBlock), elseBlock(elseBlock) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::If; }
 };
 
@@ -274,27 +288,42 @@ public:
     [[nodiscard]] StmtType getType() const override { return StmtType::Continue; }
 };
 
+/** @brief import "file.iris": makes the functions of another module callable. */
+class ImportNode : public ASTNode {
+public:
+    std::string_view path; ///< As written, relative to the importing file; characters owned by the arena
+    explicit ImportNode(const std::string_view path) : path(path) {}
+    [[nodiscard]] StmtType getType() const override { return StmtType::Import; }
+};
+
+/** @brief Point where --snapshot saves the globals and --from-snapshot resumes. */
+class SnapshotNode : public ASTNode {
+public:
+    [[nodiscard]] StmtType getType() const override { return StmtType::Snapshot; }
+};
+
 class FunctionDeclNode : public ASTNode {
 public:
-    std::string name;
+    Symbol name;
     // Each param: {name, optional type annotation}
-    std::vector<std::pair<std::string, TypeAnnotation>> params;
-    std::vector<std::unique_ptr<ASTNode>> body;
+    ParamList params;
+    NodeList body;
     TypeAnnotation returnType = TypeAnnotation::None;
-    FunctionDeclNode(std::string name,
-                     std::vector<std::pair<std::string, TypeAnnotation>> params,
-                     std::vector<std::unique_ptr<ASTNode>> body,
+    bool memoize = false; ///< Declared with @memo: results are cached per argument list
+    FunctionDeclNode(const Symbol name,
+                     ParamList params,
+                     NodeList body,
                      TypeAnnotation returnType = TypeAnnotation::None)
-        : name(std::move(name)), params(std::move(params)), body(std::move(body)),
+        : name(name), params(params), body(body),
           returnType(returnType) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::FunctionDecl; }
 };
 
 class ReturnNode : public ASTNode {
 public:
-    std::unique_ptr<ExpressionNode> expression;
-    explicit ReturnNode(std::unique_ptr<ExpressionNode> expr = nullptr)
-        : expression(std::move(expr)) {}
+    ExpressionNode* expression;
+    explicit ReturnNode(ExpressionNode* expr = nullptr)
+        : expression(expr) {}
     [[nodiscard]] StmtType getType() const override { return StmtType::Return; }
 };
 
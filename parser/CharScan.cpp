@@ -0,0 +1,141 @@
+#include "CharScan.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define IRIS_SCAN_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define IRIS_SCAN_SSE2 1
+#endif
+
+namespace {
+    /** @brief Class masks of 32 bytes, half of a CharScanner block. */
+    struct HalfMasks {
+        uint32_t space;
+        uint32_t newline;
+        uint32_t stop;
+    };
+
+#if defined(IRIS_SCAN_AVX2)
+    /*
+     * Nibble lookup: a byte is in a class if the bit is set both in loTable[low nibble]
+     * and in hiTable[high nibble]. Bits 0-3 are delimiters of rows 0x2_, 0x3_, 0x5_ and
+     * 0x7_; bit 4 is ' ', bit 5 the control whitespace of row 0x0_, bit 6 '"', bit 7 '\n'.
+     */
+    HalfMasks classify32(const char* p) {
+        const __m256i loTable = _mm256_setr_epi8(
+            0x10, 0x01, 0x40, 0x00, 0x00, 0x01, 0x01, 0x00,
+            0x01, 0x21, (char) 0xA3, 0x0B, 0x0B, 0x2B, 0x07, 0x01,
+            0x10, 0x01, 0x40, 0x00, 0x00, 0x01, 0x01, 0x00,
+            0x01, 0x21, (char) 0xA3, 0x0B, 0x0B, 0x2B, 0x07, 0x01);
+        const __m256i hiTable = _mm256_setr_epi8(
+            (char) 0xA0, 0x00, 0x51, 0x02, 0x00, 0x04, 0x00, 0x08,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+            (char) 0xA0, 0x00, 0x51, 0x02, 0x00, 0x04, 0x00, 0x08,
+            0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00);
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i lo = _mm256_shuffle_epi8(loTable, _mm256_and_si256(bytes, nibble));
+        const __m256i hi = _mm256_shuffle_epi8(hiTable, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        const __m256i cls = _mm256_and_si256(lo, hi);
+        const __m256i zero = _mm256_setzero_si256();
+
+        auto maskOf = [&](const int bits) {
+            const __m256i hit = _mm256_cmpeq_epi8(_mm256_and_si256(cls, _mm256_set1_epi8((char) bits)), zero);
+            return ~static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+        };
+        return { maskOf(0x30), maskOf(0x80), maskOf(0x7F) };
+    }
+#elif defined(IRIS_SCAN_SSE2)
+    uint32_t inRange(const __m128i bytes, const char lo, const char hi) {
+        const __m128i ge = _mm_cmpgt_epi8(bytes, _mm_set1_epi8(static_cast<char>(lo - 1)));
+        const __m128i le = _mm_cmplt_epi8(bytes, _mm_set1_epi8(static_cast<char>(hi + 1)));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_and_si128(ge, le)));
+    }
+
+    uint32_t equal(const __m128i bytes, const char c) {
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(c))));
+    }
+
+    /** @brief Masks of 16 bytes; delimiters are the ranges "(-/", ":->", "{-}" plus four singles. */
+    HalfMasks classify16(const char* p) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const uint32_t newline = equal(bytes, '\n');
+        const uint32_t space = newline | equal(bytes, ' ') | equal(bytes, '\t') | equal(bytes, '\r');
+        const uint32_t delimiter = inRange(bytes, '(', '/') | inRange(bytes, ':', '>') | inRange(bytes, '{', '}') |
+                                   equal(bytes, '!') | equal(bytes, '%') | equal(bytes, '&') | equal(bytes, '^');
+        return { space, newline, space | delimiter | equal(bytes, '"') };
+    }
+
+    HalfMasks classify32(const char* p) {
+        const HalfMasks low = classify16(p);
+        const HalfMasks high = classify16(p + 16);
+        return { low.space | high.space << 16, low.newline | high.newline << 16, low.stop | high.stop << 16 };
+    }
+#else
+    HalfMasks classify32(const char* p) {
+        HalfMasks masks{};
+        for (size_t k = 0; k < 32; k++) {
+            const uint8_t cls = charClass(p[k]);
+            const uint32_t bit = 1u << k;
+            if (cls & CHAR_SPACE) masks.space |= bit;
+            if (cls & CHAR_NEWLINE) masks.newline |= bit;
+            if (cls) masks.stop |= bit;
+        }
+        return masks;
+    }
+#endif
+}
+
+void CharScanner::load(const size_t i) {
+    const size_t start = i & ~(BLOCK - 1);
+    if (start == blockStart) return;
+    blockStart = start;
+
+    const char* p = source.data() + start;
+    char padded[BLOCK];
+    if (start + BLOCK > source.size()) {
+        // Last block: pad with spaces, which end words and are clamped away by the callers
+        const size_t n = source.size() - start;
+        std::memcpy(padded, p, n);
+        std::memset(padded + n, ' ', BLOCK - n);
+        p = padded;
+    }
+    const HalfMasks low = classify32(p);
+    const HalfMasks high = classify32(p + 32);
+    masks.space = low.space | static_cast<uint64_t>(high.space) << 32;
+    masks.newline = low.newline | static_cast<uint64_t>(high.newline) << 32;
+    masks.stop = low.stop | static_cast<uint64_t>(high.stop) << 32;
+}
+
+size_t CharScanner::skipWhitespace(size_t i, uint32_t& line) {
+    while (i < source.size()) {
+        load(i);
+        const size_t offset = i - blockStart;
+        const uint64_t newlines = masks.newline >> offset;
+        if (const uint64_t rest = ~masks.space >> offset) {
+            const int run = std::countr_zero(rest);
+            line += std::popcount(newlines & ((uint64_t{1} << run) - 1));
+            return i + run;
+        }
+        line += std::popcount(newlines);
+        i = blockStart + BLOCK;
+    }
+    return source.size();
+}
+
+size_t CharScanner::scanWord(size_t i) {
+    while (i < source.size()) {
+        load(i);
+        if (const uint64_t stop = masks.stop >> (i - blockStart)) {
+            return std::min(i + std::countr_zero(stop), source.size());
+        }
+        i = blockStart + BLOCK;
+    }
+    return source.size();
+}
@@ -0,0 +1,72 @@
+#ifndef CHARSCAN_H
+#define CHARSCAN_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+/** @brief Byte classes the lexer branches on; a byte with none of them belongs to a word. */
+enum CharClass : uint8_t {
+    CHAR_SPACE     = 1, ///< ' ', '\t', '\r', '\n'
+    CHAR_NEWLINE   = 2, ///< '\n' (also CHAR_SPACE)
+    CHAR_DELIMITER = 4, ///< Single-character operators and punctuation
+    CHAR_QUOTE     = 8  ///< '"'
+};
+
+namespace detail {
+    constexpr std::array<uint8_t, 256> makeCharClasses() {
+        std::array<uint8_t, 256> table{};
+        for (const unsigned char c : std::string_view(" \t\r\n")) table[c] |= CHAR_SPACE;
+        table['\n'] |= CHAR_NEWLINE;
+        for (const unsigned char c : std::string_view("{},.+-*/%=()<>!&|^;:")) table[c] |= CHAR_DELIMITER;
+        table['"'] |= CHAR_QUOTE;
+        return table;
+    }
+
+    inline constexpr std::array<uint8_t, 256> charClasses = makeCharClasses();
+}
+
+/** @brief CharClass bits of one byte (scalar lookup). */
+constexpr uint8_t charClass(const char c) {
+    return detail::charClasses[static_cast<unsigned char>(c)];
+}
+
+/**
+ * @brief Finds the ends of whitespace runs and words with SIMD byte classification.
+ * The source is split into 64-byte blocks; each block is classified once (AVX2, SSE2 or
+ * a scalar table, chosen at compile time) into bitmasks, and every token inside it is
+ * then delimited with bit scans on the cached masks.
+ */
+class CharScanner {
+public:
+    static constexpr size_t BLOCK = 64;
+
+    /** @brief One bit per byte of a block, set if the byte is in the class. */
+    struct BlockMasks {
+        uint64_t space;
+        uint64_t newline;
+        uint64_t stop; ///< Whitespace, delimiter or quote: ends a word
+    };
+
+    explicit CharScanner(std::string_view source) : source(source) {}
+
+    /**
+     * @brief Index of the first non-whitespace byte at or after i (source size if none).
+     * Adds the newlines skipped over to line.
+     */
+    size_t skipWhitespace(size_t i, uint32_t& line);
+
+    /** @brief Index of the first whitespace, delimiter or quote byte at or after i (source size if none). */
+    size_t scanWord(size_t i);
+
+private:
+    std::string_view source;
+    size_t blockStart = SIZE_MAX; ///< Offset of the block masks describes
+    BlockMasks masks{};
+
+    /** @brief Classifies the block containing i unless it is the cached one. */
+    void load(size_t i);
+};
+
+#endif //CHARSCAN_H
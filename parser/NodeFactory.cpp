@@ -1,317 +1,375 @@
 #include "NodeFactory.h"
 #include <stdexcept>
-#include <charconv>
+#include <algorithm>
+#include <utility>
 #include "../node/ASTNode.h"
 
+NodeFactory::NodeFactory(const std::string_view source, Arena& arena, Arena& declArena)
+    : source(source), arena(&arena), declArena(declArena) {}
+
+std::string_view NodeFactory::spelling(const Token& token) const {
+    return token.text(source);
+}
+
+std::runtime_error NodeFactory::syntaxError(const std::vector<Token>& tokens, const size_t index, const std::string& message) {
+    if (tokens.empty()) return std::runtime_error(message);
+    const Token& at = tokens[std::min(index, tokens.size() - 1)];
+    return std::runtime_error("line " + std::to_string(at.line) + ": " + message);
+}
+
 // Helper: parse optional ': type' annotation. Advances index if found.
-static TypeAnnotation tryParseTypeAnnot(const std::vector<std::string_view>& tokens, size_t& index) {
-    if (index < tokens.size() && tokens[index] == ":") {
+TypeAnnotation NodeFactory::tryParseTypeAnnot(const std::vector<Token>& tokens, size_t& index) const {
+    if (index < tokens.size() && tokens[index].symbol == Sym::Colon) {
         index++;
-        if (index >= tokens.size()) throw std::runtime_error("Expected type after ':'");
-        TypeAnnotation t = parseTypeAnnotation(tokens[index]);
+        if (index >= tokens.size()) throw syntaxError(tokens, index, "Expected type after ':'");
+        const std::string_view name = spelling(tokens[index]);
+        TypeAnnotation t = parseTypeAnnotation(name);
         if (t == TypeAnnotation::None)
-            throw std::runtime_error("Unknown type '" + std::string(tokens[index]) + "'. Use: int, double, bool, string");
+            throw syntaxError(tokens, index, "Unknown type '" + std::string(name) + "'. Use: int, double, bool, string");
         index++;
         return t;
     }
     return TypeAnnotation::None;
 }
 
-NodeFactory::NodeFactory() {
-    init();
-}
-
-std::unique_ptr<WaitNode> NodeFactory::parseWaitNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'wait'");
+ASTNode* NodeFactory::parseWaitNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'wait'");
     index++;
     auto expr = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'wait' argument");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'wait' argument");
     index++;
-    return std::make_unique<WaitNode>(std::move(expr));
+    return arena->make<WaitNode>(expr);
 }
 
-std::unique_ptr<MoveNode> NodeFactory::parseMoveNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'move'");
+ASTNode* NodeFactory::parseMoveNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'move'");
     index++;
     auto x = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ",") throw std::runtime_error("Expected ',' in 'move'");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::Comma) throw syntaxError(tokens, index, "Expected ',' in 'move'");
     index++;
     auto y = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'move' arguments");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'move' arguments");
     index++;
-    return std::make_unique<MoveNode>(std::move(x), std::move(y));
+    return arena->make<MoveNode>(x, y);
 }
 
-std::unique_ptr<ClickNode> NodeFactory::parseClickNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'click'");
+ASTNode* NodeFactory::parseClickNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'click'");
     index++;
-    if (index >= tokens.size()) throw std::runtime_error("Unexpected end of script");
-    const std::string_view btn = tokens[index++];
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'click' argument");
+    if (index >= tokens.size()) throw syntaxError(tokens, index, "Unexpected end of script");
+    const std::string_view btn = spelling(tokens[index++]);
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'click' argument");
     index++;
-    return std::make_unique<ClickNode>(btn == "right" ? ClickNode::Right : ClickNode::Left);
+    return arena->make<ClickNode>(btn == "right" ? ClickNode::Right : ClickNode::Left);
 }
 
-std::unique_ptr<ShiftNode> NodeFactory::parseShiftNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'shift'");
+ASTNode* NodeFactory::parseShiftNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'shift'");
     index++;
     auto dx = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ",") throw std::runtime_error("Expected ',' in 'shift'");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::Comma) throw syntaxError(tokens, index, "Expected ',' in 'shift'");
     index++;
     auto dy = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'shift' arguments");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'shift' arguments");
     index++;
-    return std::make_unique<ShiftNode>(std::move(dx), std::move(dy));
+    return arena->make<ShiftNode>(dx, dy);
 }
 
-std::unique_ptr<WriteNode> NodeFactory::parseWriteNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'write'");
+ASTNode* NodeFactory::parseWriteNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'write'");
     index++;
     auto expr = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'write' argument");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'write' argument");
     index++;
-    return std::make_unique<WriteNode>(std::move(expr));
+    return arena->make<WriteNode>(expr);
 }
 
-std::unique_ptr<PressNode> NodeFactory::parsePressNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'press'");
+ASTNode* NodeFactory::parsePressNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'press'");
     index++;
-    if (index >= tokens.size()) throw std::runtime_error("Unexpected end of script");
-    std::string key(tokens[index++]);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'press' argument");
+    if (index >= tokens.size()) throw syntaxError(tokens, index, "Unexpected end of script");
+    const std::string_view key = arena->copy(spelling(tokens[index++]));
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'press' argument");
     index++;
-    return std::make_unique<PressNode>(key);
+    return arena->make<PressNode>(key);
 }
 
-std::unique_ptr<VarDeclNode> NodeFactory::parseVarDeclNode(const std::vector<std::string_view> &tokens, size_t &index, bool isMutable) {
+VarDeclNode* NodeFactory::parseVarDeclNode(const std::vector<Token> &tokens, size_t &index, bool isMutable) {
     if (index >= tokens.size()) return nullptr;
-    std::string name(tokens[index++]);
+    const std::string_view nameText = spelling(tokens[index]);
+    const Symbol name = tokens[index++].symbol;
 
     // Optional type annotation: var x : int = ...
     TypeAnnotation typeAnnot = tryParseTypeAnnot(tokens, index);
 
-    if (index >= tokens.size() || tokens[index] != "=") {
-        throw std::runtime_error("Expected '=' after variable name '" + name + "'");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::Assign) {
+        throw syntaxError(tokens, index, "Expected '=' after variable name '" + std::string(nameText) + "'");
     }
     index++;
-    return std::make_unique<VarDeclNode>(name, parseExpression(tokens, index), isMutable, typeAnnot);
+    return arena->make<VarDeclNode>(name, parseExpression(tokens, index), isMutable, typeAnnot);
 }
 
-std::unique_ptr<AssignmentNode> NodeFactory::parseAssigmentNode(const std::string& cmd, const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index < tokens.size() && tokens[index] == "=") {
+AssignmentNode* NodeFactory::parseAssigmentNode(const Symbol cmd, const std::vector<Token> &tokens, size_t &index) {
+    if (index < tokens.size() && tokens[index].symbol == Sym::Assign) {
         index++;
-        return std::make_unique<AssignmentNode>(cmd, parseExpression(tokens, index));
+        return arena->make<AssignmentNode>(cmd, parseExpression(tokens, index));
     }
     return nullptr;
 }
 
-std::unique_ptr<ASTNode> NodeFactory::parseRepeatBlock(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'repeat'");
+ASTNode* NodeFactory::parseRepeatBlock(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'repeat'");
     index++;
     auto count = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after repeat count");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after repeat count");
     index++;
     auto nodes = parseBlock(tokens, index);
-    return std::make_unique<RepeatNode>(std::move(count), std::move(nodes));
+    return arena->make<RepeatNode>(count, nodes);
 }
 
-std::unique_ptr<ASTNode> NodeFactory::parseWhileBlock(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'while'");
+ASTNode* NodeFactory::parseWhileBlock(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'while'");
     index++;
     auto condition = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after while condition");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after while condition");
     index++;
-    return std::make_unique<WhileNode>(std::move(condition), parseBlock(tokens, index));
+    return arena->make<WhileNode>(condition, parseBlock(tokens, index));
 }
 
-std::unique_ptr<ASTNode> NodeFactory::parseForBlock(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'for'");
+ASTNode* NodeFactory::parseForBlock(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'for'");
     index++;
 
-    std::unique_ptr<ASTNode> init = nullptr;
-    if (index < tokens.size() && tokens[index] != ";") {
-        std::string initCmd(tokens[index++]);
+    ASTNode* init = nullptr;
+    if (index < tokens.size() && tokens[index].symbol != Sym::Semicolon) {
+        const Symbol initCmd = tokens[index++].symbol;
         init = create(initCmd, tokens, index);
     }
-    if (index >= tokens.size() || tokens[index] != ";") throw std::runtime_error("Expected ';' after for-loop init");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::Semicolon) throw syntaxError(tokens, index, "Expected ';' after for-loop init");
     index++;
 
     auto condition = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ";") throw std::runtime_error(
+    if (index >= tokens.size() || tokens[index].symbol != Sym::Semicolon) throw syntaxError(tokens, index,
         "Expected ';' after for-loop condition");
     index++;
 
-    std::unique_ptr<ASTNode> increment = nullptr;
-    if (index < tokens.size() && tokens[index] != ")") {
-        std::string incrCmd(tokens[index++]);
+    ASTNode* increment = nullptr;
+    if (index < tokens.size() && tokens[index].symbol != Sym::RParen) {
+        const Symbol incrCmd = tokens[index++].symbol;
         increment = create(incrCmd, tokens, index);
     }
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error(
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index,
         "Expected ')' after for-loop increment");
     index++;
 
     auto body = parseBlock(tokens, index);
-    return std::make_unique<ForNode>(std::move(init), std::move(condition), std::move(increment), std::move(body));
+    return arena->make<ForNode>(init, condition, increment, body);
 }
 
-std::unique_ptr<ASTNode> NodeFactory::parseIfBlock(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'if'");
+ASTNode* NodeFactory::parseIfBlock(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'if'");
     index++;
     auto condition = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after if condition");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after if condition");
     index++;
 
     auto thenBlock = parseBlock(tokens, index);
 
-    std::vector<std::unique_ptr<ASTNode>> elseBlock;
-    if (index < tokens.size() && tokens[index] == "else") {
+    NodeList elseBlock;
+    if (index < tokens.size() && tokens[index].symbol == Sym::Else) {
         index++;
-        if (index < tokens.size() && tokens[index] == "if") {
+        if (index < tokens.size() && tokens[index].symbol == Sym::If) {
             index++;
-            elseBlock.push_back(parseIfBlock(tokens, index));
-        } else if (index < tokens.size() && tokens[index] == "{") {
-            for (auto block = parseBlock(tokens, index);
-                auto& node : block) {
-                elseBlock.push_back(std::move(node));
-            }
+            elseBlock = arena->list(std::vector{parseIfBlock(tokens, index)});
+        } else if (index < tokens.size() && tokens[index].symbol == Sym::LBrace) {
+            elseBlock = parseBlock(tokens, index);
         } else {
-            throw std::runtime_error("Expected '{' or 'if' after 'else'");
+            throw syntaxError(tokens, index, "Expected '{' or 'if' after 'else'");
         }
     }
-    return std::make_unique<IfNode>(std::move(condition), std::move(thenBlock), std::move(elseBlock));
+    return arena->make<IfNode>(condition, thenBlock, elseBlock);
 }
 
 
-std::vector<std::unique_ptr<ASTNode>> NodeFactory::parseBlock(const std::vector<std::string_view> &tokens, size_t &index) {
-     if (index >= tokens.size() || tokens[index] != "{") throw std::runtime_error("Expected '{' to start a block");
+NodeList NodeFactory::parseBlock(const std::vector<Token> &tokens, size_t &index) {
+     if (index >= tokens.size() || tokens[index].symbol != Sym::LBrace) throw syntaxError(tokens, index, "Expected '{' to start a block");
      index++;
 
-     std::vector<std::unique_ptr<ASTNode>> nodes;
-     while (index < tokens.size() && tokens[index] != "}") {
-         std::string cmd(tokens[index++]);
+     std::vector<ASTNode*> nodes;
+     while (index < tokens.size() && tokens[index].symbol != Sym::RBrace) {
+         const Symbol cmd = tokens[index++].symbol;
          if (auto node = create(cmd, tokens, index)) {
-             nodes.push_back(std::move(node));
+             nodes.push_back(node);
          }
      }
-     if (index >= tokens.size()) throw std::runtime_error("Expected '}' to end a block");
+     if (index >= tokens.size()) throw syntaxError(tokens, index, "Expected '}' to end a block");
      index++;
-     return nodes;
+     return arena->list(nodes);
 }
 
 
-std::unique_ptr<ASTNode> NodeFactory::parsePrintNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after 'print'");
+ASTNode* NodeFactory::parsePrintNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after 'print'");
     index++;
     auto expr = parseExpression(tokens, index);
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after 'print' message");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after 'print' message");
     index++;
-    return std::make_unique<PrintNode>(std::move(expr));
+    return arena->make<PrintNode>(expr);
 }
 
-std::unique_ptr<ASTNode> NodeFactory::parseFunctionDecl(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size()) throw std::runtime_error("Expected function name after 'fun'");
-    std::string funcName(tokens[index++]);
+ASTNode* NodeFactory::parseFunctionDecl(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size()) throw syntaxError(tokens, index, "Expected function name after 'fun'");
+    // Bodies are compiled lazily, possibly after the batch that declared them is released
+    Arena* const statementArena = std::exchange(arena, &declArena);
+    const Symbol funcName = tokens[index++].symbol;
 
-    if (index >= tokens.size() || tokens[index] != "(") throw std::runtime_error("Expected '(' after function name");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::LParen) throw syntaxError(tokens, index, "Expected '(' after function name");
     index++;
 
     // Each param: {name, optional type annotation}
-    std::vector<std::pair<std::string, TypeAnnotation>> params;
-    while (index < tokens.size() && tokens[index] != ")") {
-        std::string pname(tokens[index++]);
+    std::vector<std::pair<Symbol, TypeAnnotation>> params;
+    while (index < tokens.size() && tokens[index].symbol != Sym::RParen) {
+        const Symbol pname = tokens[index++].symbol;
         // Optional ': type' per parameter
         TypeAnnotation ptype = tryParseTypeAnnot(tokens, index);
-        params.emplace_back(std::move(pname), ptype);
-        if (index < tokens.size() && tokens[index] == ",") {
+        params.emplace_back(pname, ptype);
+        if (index < tokens.size() && tokens[index].symbol == Sym::Comma) {
             index++;
         }
     }
-    if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')' after parameters");
+    if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')' after parameters");
     index++;
 
     // Optional return type annotation: fun foo(...) : int { ... }
     TypeAnnotation returnType = tryParseTypeAnnot(tokens, index);
 
     auto body = parseBlock(tokens, index);
-    return std::make_unique<FunctionDeclNode>(std::move(funcName), std::move(params), std::move(body), returnType);
+    auto decl = arena->make<FunctionDeclNode>(funcName, arena->list(params), body, returnType);
+    arena = statementArena;
+    return decl;
 }
 
-std::unique_ptr<ASTNode> NodeFactory::parseReturnNode(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size() || tokens[index] == "}") {
-        return std::make_unique<ReturnNode>(nullptr);
+ASTNode* NodeFactory::parseReturnNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol == Sym::RBrace) {
+        return arena->make<ReturnNode>(nullptr);
     }
     auto expr = parseExpression(tokens, index);
-    return std::make_unique<ReturnNode>(std::move(expr));
-}
-
-void NodeFactory::init() {
-    auto wrap = [this](auto method) {
-        return [this, method](const std::vector<std::string_view>& t, size_t& i) { return (this->*method)(t, i); };
-    };
-
-    mouseHandlers["click"] = wrap(&NodeFactory::parseClickNode);
-    mouseHandlers["move"] = wrap(&NodeFactory::parseMoveNode);
-    mouseHandlers["shift"] = wrap(&NodeFactory::parseShiftNode);
-
-    keyboardHandlers["write"] = wrap(&NodeFactory::parseWriteNode);
-    keyboardHandlers["press"] = wrap(&NodeFactory::parsePressNode);
-
-    handlers["repeat"] = wrap(&NodeFactory::parseRepeatBlock);
-    handlers["while"] = wrap(&NodeFactory::parseWhileBlock);
-    handlers["for"] = wrap(&NodeFactory::parseForBlock);
-    handlers["if"] = wrap(&NodeFactory::parseIfBlock);
-    handlers["wait"] = wrap(&NodeFactory::parseWaitNode);
-    handlers["print"] = wrap(&NodeFactory::parsePrintNode);
-    handlers["fun"] = wrap(&NodeFactory::parseFunctionDecl);
-    handlers["return"] = wrap(&NodeFactory::parseReturnNode);
-
-    handlers["break"] = [](const std::vector<std::string_view> &, size_t &) -> std::unique_ptr<ASTNode> {
-        return std::make_unique<BreakNode>();
-    };
-    handlers["continue"] = [](const std::vector<std::string_view> &, size_t &) -> std::unique_ptr<ASTNode> {
-        return std::make_unique<ContinueNode>();
-    };
-
-    handlers["mouse"] = [this](const std::vector<std::string_view>& t, size_t& i) -> std::unique_ptr<ASTNode> {
-        if (i >= t.size()) return nullptr;
-        if (t[i] == "{") { i++; return parseMouseBlock(t, i); }
-        if (t[i] == ".") {
-            i++;
-            if (const std::string cmd(t[i++]); mouseHandlers.contains(cmd)) return mouseHandlers[cmd](t, i);
-        }
-        return nullptr;
-    };
-
-    handlers["keyboard"] = [this](const std::vector<std::string_view>& t, size_t& i) -> std::unique_ptr<ASTNode> {
-        if (i >= t.size()) return nullptr;
-        if (t[i] == "{") { i++; return parseKeyboardBlock(t, i); }
-        if (t[i] == ".") {
-            i++;
-            if (const std::string cmd(t[i++]); keyboardHandlers.contains(cmd)) return keyboardHandlers[cmd](t, i);
-        }
-        return nullptr;
-    };
+    return arena->make<ReturnNode>(expr);
+}
+
+ASTNode* NodeFactory::parseMemoFunction(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].symbol != Sym::Fun) throw syntaxError(tokens, index, "Expected 'fun' after '@memo'");
+    index++;
+    auto decl = parseFunctionDecl(tokens, index);
+    static_cast<FunctionDeclNode*>(decl)->memoize = true;
+    return decl;
+}
+
+ASTNode* NodeFactory::parseBreakNode(const std::vector<Token> &, size_t &) {
+    return arena->make<BreakNode>();
+}
+
+ASTNode* NodeFactory::parseContinueNode(const std::vector<Token> &, size_t &) {
+    return arena->make<ContinueNode>();
+}
+
+ASTNode* NodeFactory::parseSnapshotNode(const std::vector<Token> &, size_t &) {
+    return arena->make<SnapshotNode>();
+}
 
-    handlers["var"] = [this](const std::vector<std::string_view>& t, size_t& i) { return parseVarDeclNode(t, i, true); };
-    handlers["val"] = [this](const std::vector<std::string_view>& t, size_t& i) { return parseVarDeclNode(t, i, false); };
+ASTNode* NodeFactory::parseImportNode(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size() || tokens[index].kind != TokenKind::String) throw syntaxError(tokens, index, "Expected a file name after 'import'");
+    const std::string_view text = spelling(tokens[index++]);
+    return arena->make<ImportNode>(arena->copy(text.substr(1, text.size() - 2)));
 }
 
-std::unique_ptr<ASTNode> NodeFactory::create(const std::string& command, const std::vector<std::string_view>& tokens, size_t& index) {
-    if (handlers.contains(command)) return handlers[command](tokens, index);
-    if (index < tokens.size() && tokens[index] == "=") return parseAssigmentNode(command, tokens, index);
-    if (index < tokens.size() && tokens[index] == "(") {
+ASTNode* NodeFactory::parseVarNode(const std::vector<Token> &tokens, size_t &index) {
+    return parseVarDeclNode(tokens, index, true);
+}
+
+ASTNode* NodeFactory::parseValNode(const std::vector<Token> &tokens, size_t &index) {
+    return parseVarDeclNode(tokens, index, false);
+}
+
+ASTNode* NodeFactory::parseMouseCommand(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size()) return nullptr;
+    if (tokens[index].symbol == Sym::LBrace) { index++; return parseMouseBlock(tokens, index); }
+    if (tokens[index].symbol == Sym::Dot) {
+        index++;
+        if (const Handler handler = lookup(mouseHandlers, tokens[index++].symbol)) return (this->*handler)(tokens, index);
+    }
+    return nullptr;
+}
+
+ASTNode* NodeFactory::parseKeyboardCommand(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size()) return nullptr;
+    if (tokens[index].symbol == Sym::LBrace) { index++; return parseKeyboardBlock(tokens, index); }
+    if (tokens[index].symbol == Sym::Dot) {
+        index++;
+        if (const Handler handler = lookup(keyboardHandlers, tokens[index++].symbol)) return (this->*handler)(tokens, index);
+    }
+    return nullptr;
+}
+
+/*
+ * Keywords and built-ins are fixed symbols with dense ids below Sym::COUNT, so the id
+ * itself is a perfect hash: each table is a constexpr array of member-function pointers
+ * indexed by symbol, and an empty slot means the symbol has no handler there.
+ */
+constexpr NodeFactory::HandlerTable NodeFactory::makeHandlerTable(
+    const std::initializer_list<std::pair<Symbol, Handler>> entries) {
+    HandlerTable table{};
+    for (const auto& [symbol, handler] : entries) table[symbol] = handler;
+    return table;
+}
+
+constexpr NodeFactory::HandlerTable NodeFactory::statementHandlers = makeHandlerTable({
+    {Sym::Repeat, &NodeFactory::parseRepeatBlock},
+    {Sym::While, &NodeFactory::parseWhileBlock},
+    {Sym::For, &NodeFactory::parseForBlock},
+    {Sym::If, &NodeFactory::parseIfBlock},
+    {Sym::Wait, &NodeFactory::parseWaitNode},
+    {Sym::Print, &NodeFactory::parsePrintNode},
+    {Sym::Fun, &NodeFactory::parseFunctionDecl},
+    {Sym::Return, &NodeFactory::parseReturnNode},
+    {Sym::Memo, &NodeFactory::parseMemoFunction},
+    {Sym::Break, &NodeFactory::parseBreakNode},
+    {Sym::Continue, &NodeFactory::parseContinueNode},
+    {Sym::Snapshot, &NodeFactory::parseSnapshotNode},
+    {Sym::Import, &NodeFactory::parseImportNode},
+    {Sym::Mouse, &NodeFactory::parseMouseCommand},
+    {Sym::Keyboard, &NodeFactory::parseKeyboardCommand},
+    {Sym::Var, &NodeFactory::parseVarNode},
+    {Sym::Val, &NodeFactory::parseValNode},
+});
+
+constexpr NodeFactory::HandlerTable NodeFactory::mouseHandlers = makeHandlerTable({
+    {Sym::Click, &NodeFactory::parseClickNode},
+    {Sym::Move, &NodeFactory::parseMoveNode},
+    {Sym::Shift, &NodeFactory::parseShiftNode},
+});
+
+constexpr NodeFactory::HandlerTable NodeFactory::keyboardHandlers = makeHandlerTable({
+    {Sym::Write, &NodeFactory::parseWriteNode},
+    {Sym::Press, &NodeFactory::parsePressNode},
+});
+
+ASTNode* NodeFactory::create(const Symbol command, const std::vector<Token>& tokens, size_t& index) {
+    if (const Handler handler = lookup(statementHandlers, command)) return (this->*handler)(tokens, index);
+    if (index < tokens.size() && tokens[index].symbol == Sym::Assign) return parseAssigmentNode(command, tokens, index);
+    if (index < tokens.size() && tokens[index].symbol == Sym::LParen) {
         size_t saved = index;
         index--;
         index = saved;
         index++;
-        std::vector<std::unique_ptr<ExpressionNode> > args;
-        while (index < tokens.size() && tokens[index] != ")") {
+        std::vector<ExpressionNode*> args;
+        while (index < tokens.size() && tokens[index].symbol != Sym::RParen) {
             args.push_back(parseExpression(tokens, index));
-            if (index < tokens.size() && tokens[index] == ",") {
+            if (index < tokens.size() && tokens[index].symbol == Sym::Comma) {
                 index++;
             }
         }
-        if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error(
+        if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index,
             "Expected ')' after function arguments");
         index++;
         index = saved;
@@ -320,160 +378,114 @@ std::unique_ptr<ASTNode> NodeFactory::create(const std::string& command, const s
     return nullptr;
 }
 
-std::unique_ptr<MouseBlockNode> NodeFactory::parseMouseBlock(const std::vector<std::string_view>& tokens, size_t& index) {
-    auto block = std::make_unique<MouseBlockNode>();
-    while (index < tokens.size() && tokens[index] != "}") {
-        const std::string cmd(tokens[index++]);
-        if (mouseHandlers.contains(cmd)) {
-            block->actions.push_back(mouseHandlers[cmd](tokens, index));
+MouseBlockNode* NodeFactory::parseMouseBlock(const std::vector<Token>& tokens, size_t& index) {
+    auto block = arena->make<MouseBlockNode>();
+    std::vector<ASTNode*> actions;
+    while (index < tokens.size() && tokens[index].symbol != Sym::RBrace) {
+        if (const Handler handler = lookup(mouseHandlers, tokens[index++].symbol)) {
+            actions.push_back((this->*handler)(tokens, index));
         }
     }
     if (index < tokens.size()) index++;
+    block->actions = arena->list(actions);
     return block;
 }
 
-std::unique_ptr<KeyboardBlockNode> NodeFactory::parseKeyboardBlock(const std::vector<std::string_view>& tokens, size_t& index) {
-    auto block = std::make_unique<KeyboardBlockNode>();
-    while (index < tokens.size() && tokens[index] != "}") {
-        if (std::string cmd(tokens[index++]);
-            keyboardHandlers.contains(cmd)) block->actions.push_back(keyboardHandlers[cmd](tokens, index));
+KeyboardBlockNode* NodeFactory::parseKeyboardBlock(const std::vector<Token>& tokens, size_t& index) {
+    auto block = arena->make<KeyboardBlockNode>();
+    std::vector<ASTNode*> actions;
+    while (index < tokens.size() && tokens[index].symbol != Sym::RBrace) {
+        if (const Handler handler = lookup(keyboardHandlers, tokens[index++].symbol)) {
+            actions.push_back((this->*handler)(tokens, index));
+        }
     }
     if (index < tokens.size()) index++;
+    block->actions = arena->list(actions);
     return block;
 }
 
 
-std::unique_ptr<ExpressionNode> NodeFactory::parseExpression(const std::vector<std::string_view> &tokens, size_t &index) {
-    return parseLogic(tokens, index);
-}
-
-std::unique_ptr<ExpressionNode> NodeFactory::parseLogic(const std::vector<std::string_view> &tokens, size_t &index) {
-    auto left = parseBitwise(tokens, index);
-    while (index < tokens.size()) {
-        std::string_view op = tokens[index];
-        if (op != "&&" && op != "||") break;
-        index++;
-        left = std::make_unique<BinaryOperationNode>(std::move(left), parseBitwise(tokens, index), std::string(op));
-    }
-    return left;
-}
-
-std::unique_ptr<ExpressionNode> NodeFactory::parseBitwise(const std::vector<std::string_view> &tokens, size_t &index) {
-    auto left = parseComparison(tokens, index);
-    while (index < tokens.size()) {
-        std::string op(tokens[index]);
-        if (op != "&" && op != "|" && op != "^") break;
-        index++;
-        left = std::make_unique<BinaryOperationNode>(std::move(left), parseComparison(tokens, index), op);
-    }
-    return left;
-}
-
-std::unique_ptr<ExpressionNode> NodeFactory::parseComparison(const std::vector<std::string_view> &tokens, size_t &index) {
-    auto left = parseShift(tokens, index);
-    while (index < tokens.size()) {
-        std::string_view op = tokens[index];
-        if (op != "==" && op != "!=" && op != "<" && op != ">" && op != "<=" && op != ">=") break;
-        index++;
-        left = std::make_unique<BinaryOperationNode>(std::move(left), parseShift(tokens, index), std::string(op));
-    }
-    return left;
-}
-
-std::unique_ptr<ExpressionNode> NodeFactory::parseShift(const std::vector<std::string_view> &tokens, size_t &index) {
-    auto left = parseAdditive(tokens, index);
-    while (index < tokens.size()) {
-        std::string_view op = tokens[index];
-        if (op != "<<" && op != ">>") break;
-        index++;
-        left = std::make_unique<BinaryOperationNode>(std::move(left), parseAdditive(tokens, index), std::string(op));
-    }
-    return left;
-}
-
-std::unique_ptr<ExpressionNode> NodeFactory::parseAdditive(const std::vector<std::string_view> &tokens, size_t &index) {
-    auto left = parseTerm(tokens, index);
-    while (index < tokens.size()) {
-        std::string_view op = tokens[index];
-        if (op != "+" && op != "-") break;
-
-        index++;
-        left = std::make_unique<BinaryOperationNode>(std::move(left), parseTerm(tokens, index), std::string(op));
-    }
-    return left;
-}
-
-std::unique_ptr<ExpressionNode> NodeFactory::parseTerm(const std::vector<std::string_view> &tokens, size_t &index) {
+/*
+ * Binding power of each binary operator, indexed by symbol; 0 means "not a binary
+ * operator" and ends the expression. Higher binds tighter; all levels are left-associative.
+ */
+static constexpr auto binaryPrecedence = [] {
+    std::array<uint8_t, Sym::COUNT> table{};
+    for (const Symbol op : {Sym::AndAnd, Sym::OrOr}) table[op] = 1;
+    for (const Symbol op : {Sym::Amp, Sym::Pipe, Sym::Caret}) table[op] = 2;
+    for (const Symbol op : {Sym::Eq, Sym::Neq, Sym::Lt, Sym::Gt, Sym::Le, Sym::Ge}) table[op] = 3;
+    for (const Symbol op : {Sym::Shl, Sym::Shr}) table[op] = 4;
+    for (const Symbol op : {Sym::Plus, Sym::Minus}) table[op] = 5;
+    for (const Symbol op : {Sym::Star, Sym::Slash, Sym::Percent}) table[op] = 6;
+    return table;
+}();
+
+ExpressionNode* NodeFactory::parseExpression(const std::vector<Token> &tokens, size_t &index, const int minPrecedence) {
     auto left = parseUnary(tokens, index);
     while (index < tokens.size()) {
-        std::string op(tokens[index]);
-        if (op != "*" && op != "/" && op != "%") break;
+        const Symbol op = tokens[index].symbol;
+        const int precedence = op < binaryPrecedence.size() ? binaryPrecedence[op] : 0;
+        if (precedence == 0 || precedence < minPrecedence) break;
         index++;
-        left = std::make_unique<BinaryOperationNode>(std::move(left), parseUnary(tokens, index), op);
+        left = arena->make<BinaryOperationNode>(left, parseExpression(tokens, index, precedence + 1), op);
     }
     return left;
 }
 
-std::unique_ptr<ExpressionNode> NodeFactory::parseUnary(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index < tokens.size() && tokens[index] == "!") {
+ExpressionNode* NodeFactory::parseUnary(const std::vector<Token> &tokens, size_t &index) {
+    if (index < tokens.size() && tokens[index].symbol == Sym::Bang) {
         index++;
-        return std::make_unique<UnaryOperationNode>("!", parseUnary(tokens, index));
+        return arena->make<UnaryOperationNode>(Sym::Bang, parseUnary(tokens, index));
     }
-    if (index < tokens.size() && tokens[index] == "-") {
+    if (index < tokens.size() && tokens[index].symbol == Sym::Minus) {
         index++;
-        return std::make_unique<UnaryOperationNode>("-", parseUnary(tokens, index));
+        return arena->make<UnaryOperationNode>(Sym::Minus, parseUnary(tokens, index));
     }
     return parseFactor(tokens, index);
 }
 
-std::unique_ptr<ExpressionNode> NodeFactory::parseFactor(const std::vector<std::string_view> &tokens, size_t &index) {
-    if (index >= tokens.size()) throw std::runtime_error("Unexpected end of expression");
-
-    std::string_view token = tokens[index++];
+ExpressionNode* NodeFactory::parseFactor(const std::vector<Token> &tokens, size_t &index) {
+    if (index >= tokens.size()) throw syntaxError(tokens, index, "Unexpected end of expression");
+
+    const Token& token = tokens[index++];
+    switch (token.kind) {
+        case TokenKind::Int:
+            return arena->make<NumberNode>(token.intValue);
+        case TokenKind::Double:
+            return arena->make<DoubleNode>(token.doubleValue);
+        case TokenKind::String: {
+            const std::string_view text = spelling(token);
+            return arena->make<StringNode>(arena->copy(text.substr(1, text.size() - 2)));
+        }
+        default:
+            break;
+    }
 
-    if (token == "(") {
+    const Symbol name = token.symbol;
+    if (name == Sym::LParen) {
         auto expr = parseExpression(tokens, index);
-        if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error("Expected ')'");
+        if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index, "Expected ')'");
         index++;
         return expr;
     }
+    if (name == Sym::True) return arena->make<BooleanNode>(true);
+    if (name == Sym::False) return arena->make<BooleanNode>(false);
 
-    if (token.starts_with('"')) {
-        return std::make_unique<StringNode>(std::string(token.substr(1, token.size() - 2)));
-    }
-
-    if (token == "true") return std::make_unique<BooleanNode>(true);
-    if (token == "false") return std::make_unique<BooleanNode>(false);
-
-    if (!token.empty() && (std::isdigit(token[0]))) {
-        if (token.find('.') != std::string_view::npos) {
-            double val;
-            auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), val);
-            if (ec == std::errc()) return std::make_unique<DoubleNode>(val);
-        } else {
-            int val;
-            auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), val);
-            if (ec == std::errc()) return std::make_unique<NumberNode>(val);
-        }
-    }
-
-    std::string name(token);
-
-    if (index < tokens.size() && tokens[index] == "(") {
+    if (index < tokens.size() && tokens[index].symbol == Sym::LParen) {
         index++;
-        std::vector<std::unique_ptr<ExpressionNode> > args;
-        if (index < tokens.size() && tokens[index] != ")") {
+        std::vector<ExpressionNode*> args;
+        if (index < tokens.size() && tokens[index].symbol != Sym::RParen) {
             args.push_back(parseExpression(tokens, index));
-            while (index < tokens.size() && tokens[index] == ",") {
+            while (index < tokens.size() && tokens[index].symbol == Sym::Comma) {
                 index++;
                 args.push_back(parseExpression(tokens, index));
             }
         }
-        if (index >= tokens.size() || tokens[index] != ")") throw std::runtime_error(
+        if (index >= tokens.size() || tokens[index].symbol != Sym::RParen) throw syntaxError(tokens, index,
             "Expected ')' after function arguments");
         index++;
-        return std::make_unique<FunctionCallNode>(std::move(name), std::move(args));
+        return arena->make<FunctionCallNode>(name, arena->list(args));
     }
 
-    return std::make_unique<VariableNode>(std::move(name));
+    return arena->make<VariableNode>(name);
 }
\ No newline at end of file
@@ -1,71 +1,94 @@
 #ifndef NODEFACTORY_H
 #define NODEFACTORY_H
 
-#include <functional>
-#include <unordered_map>
+#include <array>
+#include <initializer_list>
 #include <memory>
 #include <string>
 #include <vector>
 #include <string_view>
+#include <stdexcept>
+#include <utility>
 
+#include "../core/Arena.h"
 #include "../node/ASTNode.h"
+#include "Token.h"
 
 class NodeFactory {
 private:
-    using Handler = std::function<std::unique_ptr<ASTNode>(const std::vector<std::string_view>&, size_t&)>;
-    std::unordered_map<std::string, Handler> handlers;
+    using Handler = ASTNode* (NodeFactory::*)(const std::vector<Token>&, size_t&);
+    /** @brief Handlers indexed by fixed symbol id; nullptr where a symbol has none. */
+    using HandlerTable = std::array<Handler, Sym::COUNT>;
 
-    std::unordered_map<std::string, Handler> mouseHandlers;
-    std::unordered_map<std::string, Handler> keyboardHandlers;
+    static constexpr HandlerTable makeHandlerTable(std::initializer_list<std::pair<Symbol, Handler>> entries);
 
-    void init();
+    static const HandlerTable statementHandlers;
+    static const HandlerTable mouseHandlers;
+    static const HandlerTable keyboardHandlers;
 
-    std::vector<std::unique_ptr<ASTNode>> parseBlock(const std::vector<std::string_view>& tokens, size_t& index);
+    static Handler lookup(const HandlerTable& table, const Symbol symbol) {
+        return symbol < table.size() ? table[symbol] : nullptr;
+    }
 
-    std::unique_ptr<MouseBlockNode> parseMouseBlock(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<KeyboardBlockNode> parseKeyboardBlock(const std::vector<std::string_view>& tokens, size_t& index);
+    std::string_view source; ///< Text the tokens' spans point into
+    Arena* arena;            ///< Owns the nodes currently being created
+    Arena& declArena;        ///< Owns function declarations, which outlive a streamed batch
 
-    std::unique_ptr<ExpressionNode> parseExpression(const std::vector<std::string_view>& tokens, size_t& index);
+    [[nodiscard]] std::string_view spelling(const Token& token) const;
 
-    std::unique_ptr<ExpressionNode> parseLogic(const std::vector<std::string_view> &tokens, size_t &index);
+    /** @brief Error for the token at index, prefixed with its source line. */
+    static std::runtime_error syntaxError(const std::vector<Token>& tokens, size_t index, const std::string& message);
 
-    std::unique_ptr<ExpressionNode> parseBitwise(const std::vector<std::string_view> &tokens, size_t &index);
+    TypeAnnotation tryParseTypeAnnot(const std::vector<Token>& tokens, size_t& index) const;
 
-    std::unique_ptr<ExpressionNode> parseComparison(const std::vector<std::string_view> &tokens, size_t &index);
+    NodeList parseBlock(const std::vector<Token>& tokens, size_t& index);
 
-    std::unique_ptr<ExpressionNode> parseShift(const std::vector<std::string_view> &tokens, size_t &index);
+    MouseBlockNode* parseMouseBlock(const std::vector<Token>& tokens, size_t& index);
+    KeyboardBlockNode* parseKeyboardBlock(const std::vector<Token>& tokens, size_t& index);
 
-    std::unique_ptr<ExpressionNode> parseAdditive(const std::vector<std::string_view> &tokens, size_t &index);
+    /**
+     * @brief Precedence climbing over the binaryPrecedence table: parses operators that
+     * bind at least as tightly as minPrecedence, so each token is examined once.
+     */
+    ExpressionNode* parseExpression(const std::vector<Token>& tokens, size_t& index, int minPrecedence = 1);
 
-    std::unique_ptr<ExpressionNode> parseTerm(const std::vector<std::string_view>& tokens, size_t& index);
+    ExpressionNode* parseUnary(const std::vector<Token> &tokens, size_t &index);
 
-    std::unique_ptr<ExpressionNode> parseUnary(const std::vector<std::string_view> &tokens, size_t &index);
+    ExpressionNode* parseFactor(const std::vector<Token>& tokens, size_t& index);
 
-    std::unique_ptr<ExpressionNode> parseFactor(const std::vector<std::string_view>& tokens, size_t& index);
+    ASTNode* parseWaitNode(const std::vector<Token>& tokens, size_t& index);
+    ASTNode* parseMoveNode(const std::vector<Token>& tokens, size_t& index);
+    ASTNode* parseClickNode(const std::vector<Token>& tokens, size_t& index);
+    ASTNode* parseShiftNode(const std::vector<Token>& tokens, size_t& index);
+    ASTNode* parseWriteNode(const std::vector<Token>& tokens, size_t& index);
+    ASTNode* parsePressNode(const std::vector<Token>& tokens, size_t& index);
+    VarDeclNode* parseVarDeclNode(const std::vector<Token> &tokens, size_t &index, bool isMutable);
+    AssignmentNode* parseAssigmentNode(Symbol cmd, const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseRepeatBlock(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseWhileBlock(const std::vector<Token> &tokens, size_t &index);
 
-    std::unique_ptr<WaitNode> parseWaitNode(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<MoveNode> parseMoveNode(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<ClickNode> parseClickNode(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<ShiftNode> parseShiftNode(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<WriteNode> parseWriteNode(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<PressNode> parsePressNode(const std::vector<std::string_view>& tokens, size_t& index);
-    std::unique_ptr<VarDeclNode> parseVarDeclNode(const std::vector<std::string_view> &tokens, size_t &index, bool isMutable);
-    std::unique_ptr<AssignmentNode> parseAssigmentNode(const std::string& cmd, const std::vector<std::string_view> &tokens, size_t &index);
-    std::unique_ptr<ASTNode> parseRepeatBlock(const std::vector<std::string_view> &tokens, size_t &index);
-    std::unique_ptr<ASTNode> parseWhileBlock(const std::vector<std::string_view> &tokens, size_t &index);
+    ASTNode* parseForBlock(const std::vector<Token> &tokens, size_t &index);
 
-    std::unique_ptr<ASTNode> parseForBlock(const std::vector<std::string_view> &tokens, size_t &index);
+    ASTNode* parseIfBlock(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parsePrintNode(const std::vector<Token> &tokens, size_t &index);
 
-    std::unique_ptr<ASTNode> parseIfBlock(const std::vector<std::string_view> &tokens, size_t &index);
-    std::unique_ptr<ASTNode> parsePrintNode(const std::vector<std::string_view> &tokens, size_t &index);
+    ASTNode* parseFunctionDecl(const std::vector<Token> &tokens, size_t &index);
 
-    std::unique_ptr<ASTNode> parseFunctionDecl(const std::vector<std::string_view> &tokens, size_t &index);
+    ASTNode* parseReturnNode(const std::vector<Token> &tokens, size_t &index);
 
-    std::unique_ptr<ASTNode> parseReturnNode(const std::vector<std::string_view> &tokens, size_t &index);
+    ASTNode* parseMemoFunction(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseBreakNode(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseSnapshotNode(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseImportNode(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseContinueNode(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseVarNode(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseValNode(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseMouseCommand(const std::vector<Token> &tokens, size_t &index);
+    ASTNode* parseKeyboardCommand(const std::vector<Token> &tokens, size_t &index);
 
 public:
-    NodeFactory();
-    std::unique_ptr<ASTNode> create(const std::string &command, const std::vector<std::string_view> &tokens, size_t &index);
+    NodeFactory(std::string_view source, Arena& arena, Arena& declArena);
+    ASTNode* create(Symbol command, const std::vector<Token> &tokens, size_t &index);
 };
 
 #endif //NODEFACTORY_H
\ No newline at end of file
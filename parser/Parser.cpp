@@ -1,151 +1,315 @@
 #include "Parser.h"
 
-#include <fstream>
+#include <algorithm>
+#include <array>
+#include <charconv>
 #include <stdexcept>
 #include <iostream>
 
+#include "CharScan.h"
+#include "../core/Parallel.h"
 #include "../log/Logger.h"
 
-Parser::Parser(const std::string &filePath, Logger *logger) {
-    this->logger = logger;
-    this->file = std::ifstream(filePath, std::ios::ate | std::ios::binary);
-    if (!this->file.is_open()) {
-        throw std::runtime_error("File could not be opened: " + filePath);
-    }
-}
+Parser::Parser(const std::string &filePath, Logger *logger)
+    : Parser(filePath, logger, std::make_shared<SymbolTable>()) {}
 
-Parser::~Parser() {
-    if (this->file.is_open()) {
-        this->file.close();
-    }
-}
+Parser::Parser(const std::string &filePath, Logger *logger, std::shared_ptr<SymbolTable> symbols)
+    : logger(logger), source(filePath), scanner(source.text()), symbols(std::move(symbols)),
+      factory(source.text(), batchArena, arena) {}
 
 void Parser::parse() {
-    const size_t fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
+    tokens.reserve(source.text().length() / 4);
+    tokenize(SIZE_MAX);
+    if (tokens.size() >= PARALLEL_MIN_TOKENS) preparseFunctions();
+
+    try {
+        this->program = parseProgram();
+    } catch (const std::exception &e) {
+        logger->error(std::string("Parsing error: ") + e.what());
+    }
+}
 
-    this->sourceCode.resize(fileSize);
-    file.read(this->sourceCode.data(), static_cast<long long>(fileSize));
+ProgramNode* Parser::parseBatch() {
+    // The previous batch has been compiled; only function declarations outlive it
+    program.reset();
+    batchArena.reset();
+    tokens.clear();
+    currentToken = 0;
 
-    tokenize(this->sourceCode);
+    tokenize(STREAM_BATCH_TOKENS);
+    if (tokens.empty()) return nullptr;
 
     try {
         this->program = parseProgram();
     } catch (const std::exception &e) {
         logger->error(std::string("Parsing error: ") + e.what());
     }
+    return program.get();
 }
 
-constexpr bool isDelimiter(char c) {
-    switch (c) {
-        case '{':
-        case '}':
-        case ',':
-        case '.':
-        case '+':
-        case '-':
-        case '*':
-        case '/':
-        case '%':
-        case '=':
-        case '(':
-        case ')':
-        case '<':
-        case '>':
-        case '!':
-        case '&':
-        case '|':
-        case '^':
-        case ';':
-        case ':':   // Type annotation separator: var x : int = 5
-            return true;
-        default:
-            return false;
+/** @brief Symbol of an operator or punctuation token; all of them are fixed symbols, so none is hashed. */
+static Symbol punctSymbol(const std::string_view text) {
+    static constexpr auto singles = [] {
+        std::array<Symbol, 128> table{};
+        table.fill(NO_SYMBOL);
+        for (Symbol s = Sym::Plus; s <= Sym::Assign; s++) {
+            if (Sym::spellings[s].size() == 1) table[static_cast<unsigned char>(Sym::spellings[s][0])] = s;
+        }
+        return table;
+    }();
+    if (text.size() == 1) return singles[static_cast<unsigned char>(text[0]) & 0x7F];
+    for (Symbol s = Sym::Plus; s <= Sym::Assign; s++) {
+        if (Sym::spellings[s] == text) return s;
     }
+    return NO_SYMBOL;
 }
 
-constexpr bool isWhitespace(char c) {
-    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+/**
+ * @brief True if a top-level statement can be split off between the two tokens.
+ * The next token must be a keyword that only starts statements or a name (an assignment or
+ * call), and the previous one must end an expression or block; no expression or statement
+ * continues with either, so none can span the cut.
+ */
+static bool isStatementBoundary(const Token& previous, const Token& next) {
+    switch (next.symbol) {
+        case Sym::Var: case Sym::Val: case Sym::Fun: case Sym::Memo:
+        case Sym::If: case Sym::While: case Sym::For: case Sym::Repeat:
+        case Sym::Print: case Sym::Wait: case Sym::Mouse: case Sym::Keyboard:
+        case Sym::Snapshot: case Sym::Import:
+            break;
+        default:
+            if (next.kind != TokenKind::Name || next.symbol < Sym::COUNT) return false;
+            break;
+    }
+    switch (previous.kind) {
+        case TokenKind::Int:
+        case TokenKind::Double:
+        case TokenKind::String:
+            return true;
+        case TokenKind::Punct:
+            return previous.symbol == Sym::RParen || previous.symbol == Sym::RBrace;
+        case TokenKind::Name:
+            return previous.symbol >= Sym::COUNT || previous.symbol == Sym::True || previous.symbol == Sym::False;
+    }
+    return false;
 }
 
-void Parser::tokenize(std::string_view source) {
-    tokens.reserve(source.length() / 4);
+void Parser::tokenize(const size_t tokenLimit) {
+    const std::string_view source = this->source.text();
+    uint32_t line = lexLine;
 
-    size_t i = 0;
+    // Each token is classified once here: names and operators are interned,
+    // numbers are converted, so the parser only compares kinds and Symbol ids.
+    auto push = [&](const TokenKind kind, const size_t start, const size_t length) {
+        Token& token = tokens.emplace_back();
+        token.kind = kind;
+        token.offset = static_cast<uint32_t>(start);
+        token.length = static_cast<uint32_t>(length);
+        token.line = line;
+        const std::string_view text = source.substr(start, length);
+        const char* const first = text.data();
+        const char* const last = first + text.size();
+        std::from_chars_result parsed{};
+        switch (kind) {
+            case TokenKind::Name:
+                token.symbol = symbols->intern(text);
+                return;
+            case TokenKind::Punct:
+                token.symbol = punctSymbol(text);
+                if (token.symbol == Sym::LParen || token.symbol == Sym::LBrace) lexDepth++;
+                else if (token.symbol == Sym::RParen || token.symbol == Sym::RBrace) lexDepth--;
+                return;
+            case TokenKind::Int:
+                parsed = std::from_chars(first, last, token.intValue);
+                break;
+            case TokenKind::Double:
+                parsed = std::from_chars(first, last, token.doubleValue);
+                break;
+            case TokenKind::String:
+                return;
+        }
+        if (parsed.ec != std::errc() || parsed.ptr != last) {
+            throw std::runtime_error("line " + std::to_string(line) + ": Invalid number '" + std::string(text) + "'");
+        }
+    };
+
+    size_t i = lexPos;
     const size_t len = source.length();
 
     while (i < len) {
         const char c = source[i];
+        const uint8_t cls = charClass(c);
 
-        if (isWhitespace(c)) {
-            i++;
+        if (cls & CHAR_SPACE) {
+            i = scanner.skipWhitespace(i, line);
             continue;
         }
 
         if (c == '/' && i + 1 < len && source[i + 1] == '/') {
-            i += 2;
-            while (i < len && source[i] != '\n') i++;
+            i = std::min(source.find('\n', i + 2), len);
             continue;
         }
 
-        if (c == '"') {
+        if (cls & CHAR_QUOTE) {
             const size_t start = i;
             const size_t end = source.find('"', start + 1);
 
             if (end != std::string_view::npos) {
-                tokens.emplace_back(source.substr(start, end - start + 1));
+                push(TokenKind::String, start, end - start + 1);
+                line += static_cast<uint32_t>(std::count(source.begin() + start, source.begin() + end, '\n'));
                 i = end + 1;
             } else {
-                throw std::runtime_error("Never ending string starting at index " + std::to_string(start));
+                throw std::runtime_error("line " + std::to_string(line) + ": Never ending string");
             }
             continue;
         }
 
-        if (isDelimiter(c)) {
+        if (cls & CHAR_DELIMITER) {
             if (i + 1 < len) {
                 if (const char next = source[i + 1];
                     (c == '&' && next == '&') || (c == '|' && next == '|') ||
                     (c == '=' && next == '=') || (c == '!' && next == '=') ||
                     (c == '<' && next == '=') || (c == '>' && next == '=') ||
                     (c == '<' && next == '<') || (c == '>' && next == '>')) {
-                    tokens.emplace_back(source.substr(i, 2));
+                    push(TokenKind::Punct, i, 2);
                     i += 2;
                     continue;
                 }
             }
-            tokens.emplace_back(source.substr(i, 1));
+            push(TokenKind::Punct, i, 1);
             i++;
             continue;
         }
 
         const size_t start = i;
-        while (i < len) {
-            const char ch = source[i];
-            if (isWhitespace(ch) || ch == '"') break;
-            // Allow '.' inside numeric literals (e.g. 3.14) but not elsewhere
-            if (ch == '.' && i > start && i + 1 < len &&
-                std::isdigit(static_cast<unsigned char>(source[i - 1])) &&
-                std::isdigit(static_cast<unsigned char>(source[i + 1]))) {
-                i++;  // consume the dot as part of the number
-                continue;
+        bool fraction = false;
+        i = scanner.scanWord(i);
+        // Allow '.' inside numeric literals (e.g. 3.14) but not elsewhere
+        while (i + 1 < len && source[i] == '.' &&
+               std::isdigit(static_cast<unsigned char>(source[i - 1])) &&
+               std::isdigit(static_cast<unsigned char>(source[i + 1]))) {
+            fraction = true;
+            i = scanner.scanWord(i + 1);
+        }
+        if (std::isdigit(static_cast<unsigned char>(c))) {
+            push(fraction ? TokenKind::Double : TokenKind::Int, start, i - start);
+        } else {
+            push(TokenKind::Name, start, i - start);
+            // Stop before this statement once the batch is full; it is lexed again next time
+            if (tokens.size() > tokenLimit && lexDepth == 0 && isStatementBoundary(tokens.end()[-2], tokens.back())) {
+                tokens.pop_back();
+                i = start;
+                break;
             }
-            if (isDelimiter(ch)) break;
-            i++;
         }
-        tokens.emplace_back(source.substr(start, i - start));
     }
+    lexPos = i;
+    lexLine = line;
 }
 
 std::unique_ptr<ProgramNode> Parser::parseProgram() {
     auto prog = std::make_unique<ProgramNode>();
+    prog->symbols = symbols;
+    std::vector<ASTNode*> statements;
     while (currentToken < tokens.size()) {
-        if (std::unique_ptr<ASTNode> stmt = parseStatement()) prog->statements.push_back(std::move(stmt));
+        if (ASTNode* stmt = parseStatement()) statements.push_back(stmt);
     }
+    prog->statements = batchArena.list(statements);
     return prog;
 }
 
-std::unique_ptr<ASTNode> Parser::parseStatement() {
+void Parser::preparseFunctions() {
+    int depth = 0;
+    for (size_t i = 0; i < tokens.size(); i++) {
+        const Symbol symbol = tokens[i].symbol;
+        if (symbol == Sym::LParen || symbol == Sym::LBrace) depth++;
+        else if (symbol == Sym::RParen || symbol == Sym::RBrace) depth--;
+        else if (symbol == Sym::Fun && depth == 0) {
+            preparsed.emplace_back().start = i > 0 && tokens[i - 1].symbol == Sym::Memo ? i - 1 : i;
+        }
+    }
+    const size_t workers = workerCount(preparsed.size());
+    if (workers < 2) {
+        preparsed.clear();
+        return;
+    }
+    for (size_t w = 0; w < workers; w++) workerArenas.push_back(std::make_unique<Arena>());
+    parallelFor(preparsed.size(), workers, [&](const size_t i, const size_t worker) {
+        PreparsedFunction& decl = preparsed[i];
+        NodeFactory workerFactory(source.text(), *workerArenas[worker], *workerArenas[worker]);
+        size_t index = decl.start + 1;
+        try {
+            decl.node = workerFactory.create(tokens[decl.start].symbol, tokens, index);
+            decl.end = index;
+        } catch (...) {
+            decl.error = std::current_exception();
+        }
+    });
+}
+
+/** @brief FNV-1a step over a token's text; the separator keeps "a b" and "ab" apart. */
+static uint64_t hashToken(uint64_t hash, const std::string_view text) {
+    constexpr uint64_t FNV_PRIME = 1099511628211ull;
+    for (const char c : text) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= FNV_PRIME;
+    }
+    return hash * FNV_PRIME;
+}
+
+Parser::Outline Parser::outline() {
+    constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+    if (tokens.empty()) tokenize(SIZE_MAX);
+    const std::string_view text = source.text();
+    const auto spelling = [&](const Token& token) { return text.substr(token.offset, token.length); };
+
+    Outline outline{{}, FNV_OFFSET};
+    int depth = 0;
+    for (size_t i = 0; i < tokens.size();) {
+        const size_t fun = tokens[i].symbol == Sym::Memo && i + 1 < tokens.size() ? i + 1 : i;
+        if (depth == 0 && tokens[fun].symbol == Sym::Fun && fun + 1 < tokens.size()) {
+            // The declaration ends with the brace closing its body, the first brace after 'fun'
+            size_t end = fun + 1;
+            int braces = 0;
+            while (end < tokens.size()) {
+                const Symbol symbol = tokens[end++].symbol;
+                if (symbol == Sym::LBrace) braces++;
+                else if (symbol == Sym::RBrace && --braces == 0) break;
+            }
+            FunctionSpan span{tokens[fun + 1].symbol, i, end, FNV_OFFSET};
+            for (size_t t = i; t < end; t++) span.hash = hashToken(span.hash, spelling(tokens[t]));
+            outline.restHash = hashToken(outline.restHash, spelling(tokens[fun + 1]));
+            outline.functions.push_back(span);
+            i = end;
+            continue;
+        }
+        const Symbol symbol = tokens[i].symbol;
+        if (symbol == Sym::LParen || symbol == Sym::LBrace) depth++;
+        else if (symbol == Sym::RParen || symbol == Sym::RBrace) depth--;
+        outline.restHash = hashToken(outline.restHash, spelling(tokens[i]));
+        i++;
+    }
+    return outline;
+}
+
+FunctionDeclNode* Parser::parseFunction(const FunctionSpan& span) {
+    size_t index = span.start + 1;
+    ASTNode* node = factory.create(tokens[span.start].symbol, tokens, index);
+    if (node->getType() != StmtType::FunctionDecl || index != span.end) {
+        throw std::runtime_error("line " + std::to_string(tokens[span.start].line) + ": Malformed function declaration");
+    }
+    return static_cast<FunctionDeclNode*>(node);
+}
+
+ASTNode* Parser::parseStatement() {
     if (currentToken >= tokens.size()) return nullptr;
-    const std::string_view token = tokens[currentToken++];
-    return factory.create(std::string(token), tokens, currentToken);
+    while (nextPreparsed < preparsed.size() && preparsed[nextPreparsed].start < currentToken) nextPreparsed++;
+    if (nextPreparsed < preparsed.size() && preparsed[nextPreparsed].start == currentToken) {
+        const PreparsedFunction& decl = preparsed[nextPreparsed++];
+        if (decl.error) std::rethrow_exception(decl.error);
+        currentToken = decl.end;
+        return decl.node;
+    }
+    const Symbol command = tokens[currentToken++].symbol;
+    return factory.create(command, tokens, currentToken);
 }
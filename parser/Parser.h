@@ -2,40 +2,116 @@
 
 #ifndef PARSER_H
 #define PARSER_H
-#include <fstream>
-#include <iosfwd>
+#include <exception>
 #include <vector>
 #include <memory>
+#include "../core/Arena.h"
 #include "../node/ASTNode.h"
+#include "CharScan.h"
 #include "NodeFactory.h"
+#include "SourceFile.h"
+#include "Token.h"
 #include "../log/Logger.h"
 
 class Parser {
     private:
-    std::ifstream file;
+    /** @brief Tokens per batch in streaming mode, rounded up to the next statement boundary. */
+    static constexpr size_t STREAM_BATCH_TOKENS = 64 * 1024;
+    /** @brief Scripts with fewer tokens are parsed on one thread; starting workers would cost more. */
+    static constexpr size_t PARALLEL_MIN_TOKENS = 16 * 1024;
+
     Logger* logger;
-    std::string sourceCode;
+    SourceFile source; ///< Mapped or buffered script text; tokens point into it
+    CharScanner scanner;
 
-    std::vector<std::string_view> tokens;
+    std::vector<Token> tokens;
+    std::shared_ptr<SymbolTable> symbols;
     size_t currentToken = 0;
 
+    size_t lexPos = 0;     ///< Source offset where lexing resumes
+    uint32_t lexLine = 1;
+    int lexDepth = 0;      ///< Open parentheses and braces
+
+    Arena arena;      ///< Function declarations; released in one shot with the Parser
+    Arena batchArena; ///< All other nodes; released per batch when streaming
     NodeFactory factory;
 
-    void tokenize(std::string_view source);
+    /** @brief A top-level function declaration parsed ahead of the main pass on a worker thread. */
+    struct PreparsedFunction {
+        size_t start;             ///< Index of the statement's first token ('fun' or '@memo')
+        size_t end = 0;           ///< Index after its last token
+        ASTNode* node = nullptr;
+        std::exception_ptr error; ///< Raised when the main pass reaches the declaration
+    };
+    std::vector<PreparsedFunction> preparsed;
+    size_t nextPreparsed = 0;
+    std::vector<std::unique_ptr<Arena>> workerArenas; ///< Nodes of preparsed declarations, one arena per worker
+
+    /**
+     * @brief Finds the declarations starting with 'fun' or '@memo fun' outside any brackets
+     * and parses them in parallel. parseStatement() takes each over when it reaches its first
+     * token, so the tree and any error are the same as with a single thread.
+     */
+    void preparseFunctions();
+
+    /**
+     * @brief Lexes from lexPos, appending to tokens.
+     * Stops at the end of the source, or at the first top-level statement boundary after tokenLimit tokens.
+     */
+    void tokenize(size_t tokenLimit);
 
     std::unique_ptr<ProgramNode> parseProgram();
-    std::unique_ptr<ASTNode> parseStatement();
+    ASTNode* parseStatement();
 
     std::unique_ptr<ProgramNode> program;
 
     public:
+    /** @brief A top-level function declaration found by outline(). */
+    struct FunctionSpan {
+        Symbol name;
+        size_t start; ///< Index of the declaration's first token ('fun' or '@memo')
+        size_t end;   ///< Index after the brace closing its body
+        uint64_t hash; ///< Of the declaration's tokens
+    };
+
+    /** @brief The source split into top-level function declarations and everything else. */
+    struct Outline {
+        std::vector<FunctionSpan> functions;
+        uint64_t restHash; ///< Of the tokens outside the declarations, and of the declarations' names in order
+    };
+
+    /** @param filePath Script to parse, or SourceFile::STDIN_PATH ("-") for standard input. */
     Parser(const std::string& filePath, Logger* logger);
 
+    /** @param symbols Table to extend instead of a fresh one, so names keep their Symbol ids (--watch). */
+    Parser(const std::string& filePath, Logger* logger, std::shared_ptr<SymbolTable> symbols);
+
     void parse();
 
-    [[nodiscard]] ProgramNode* getProgram() const { return program.get(); }
+    /**
+     * @brief Streaming mode: lexes and parses the next batch of top-level statements.
+     * Tokens and nodes of the previous batch are released first, so memory stays bounded;
+     * function declarations are kept, as compiled functions refer to them.
+     * @return The batch, or nullptr at the end of the source or after a parse error.
+     */
+    ProgramNode* parseBatch();
+
+    /**
+     * @brief Watch mode: finds the top-level function declarations without parsing them.
+     * Lexes the source unless parse() already has. Hashes cover the text of the tokens
+     * only, so edits to whitespace and comments change none of them.
+     * @throws std::runtime_error on a lexical error.
+     */
+    Outline outline();
+
+    /**
+     * @brief Parses one declaration found by outline(); the node lives as long as the parser.
+     * @throws std::runtime_error on a syntax error.
+     */
+    FunctionDeclNode* parseFunction(const FunctionSpan& span);
 
-    ~Parser();
+    [[nodiscard]] ProgramNode* getProgram() const { return program.get(); }
+    [[nodiscard]] std::string_view getSource() const { return source.text(); }
 
 };
 
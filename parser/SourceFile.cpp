@@ -0,0 +1,98 @@
+#include "SourceFile.h"
+
+#include <cerrno>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+SourceFile::SourceFile(const std::string& path) {
+    const bool fromStdin = path == STDIN_PATH;
+    HANDLE file = fromStdin
+        ? GetStdHandle(STD_INPUT_HANDLE)
+        : CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE || file == nullptr) {
+        throw std::runtime_error("File could not be opened: " + path);
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        if (HANDLE handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr)) {
+            if (void* view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0)) {
+                mappingHandle = handle;
+                mapping = view;
+                data = static_cast<const char*>(view);
+                size = static_cast<size_t>(fileSize.QuadPart);
+            } else {
+                CloseHandle(handle);
+            }
+        }
+    }
+
+    if (!mapping) {
+        char chunk[64 * 1024];
+        DWORD got = 0;
+        while (ReadFile(file, chunk, sizeof(chunk), &got, nullptr) && got > 0) buffer.append(chunk, got);
+        data = buffer.data();
+        size = buffer.size();
+    }
+    if (!fromStdin) CloseHandle(file); // The mapping keeps its own reference to the file
+}
+
+SourceFile::~SourceFile() {
+    if (mapping) {
+        UnmapViewOfFile(mapping);
+        CloseHandle(mappingHandle);
+    }
+}
+
+#else
+
+SourceFile::SourceFile(const std::string& path) {
+    const bool fromStdin = path == STDIN_PATH;
+    const int fd = fromStdin ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("File could not be opened: " + path);
+    }
+
+    if (struct stat info{}; fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        const auto length = static_cast<size_t>(info.st_size);
+        if (void* view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0); view != MAP_FAILED) {
+            madvise(view, length, MADV_SEQUENTIAL);
+            mapping = view;
+            data = static_cast<const char*>(view);
+            size = length;
+        }
+    }
+
+    if (!mapping) {
+        char chunk[64 * 1024];
+        ssize_t got;
+        while ((got = ::read(fd, chunk, sizeof(chunk))) != 0) {
+            if (got < 0) {
+                if (errno == EINTR) continue;
+                if (!fromStdin) ::close(fd);
+                throw std::runtime_error("File could not be read: " + path);
+            }
+            buffer.append(chunk, static_cast<size_t>(got));
+        }
+        data = buffer.data();
+        size = buffer.size();
+    }
+    if (!fromStdin) ::close(fd); // The mapping stays valid after the descriptor is closed
+}
+
+SourceFile::~SourceFile() {
+    if (mapping) munmap(mapping, size);
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef SOURCEFILE_H
+#define SOURCEFILE_H
+
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Read-only contents of a script.
+ * Regular files are memory-mapped, so tokens view the mapping directly and the kernel
+ * pages the file in as the lexer reaches it. Anything that cannot be mapped (pipes,
+ * terminals, empty files, stdin) is read() into an owned buffer instead.
+ */
+class SourceFile {
+    const char* data = nullptr;
+    size_t size = 0;
+    std::string buffer;      ///< Contents when not mapped
+    void* mapping = nullptr; ///< Base of the mapped view, nullptr if buffered
+#ifdef _WIN32
+    void* mappingHandle = nullptr;
+#endif
+
+public:
+    /** @brief Path that selects standard input. */
+    static constexpr std::string_view STDIN_PATH = "-";
+
+    /** @throws std::runtime_error if the file cannot be opened or read. */
+    explicit SourceFile(const std::string& path);
+    ~SourceFile();
+
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+
+    [[nodiscard]] std::string_view text() const { return {data, size}; }
+    [[nodiscard]] bool isMapped() const { return mapping != nullptr; }
+};
+
+#endif //SOURCEFILE_H
@@ -0,0 +1,39 @@
+#ifndef TOKEN_H
+#define TOKEN_H
+
+#include <cstdint>
+#include <string_view>
+#include "../core/Symbol.h"
+
+/** @brief Lexical class of a token, decided once by the lexer. */
+enum class TokenKind : uint8_t {
+    Name,   ///< Identifier, keyword or built-in ("x", "while", "@memo")
+    Punct,  ///< Operator or punctuation ("+", "<=", "{")
+    Int,    ///< Integer literal, value in intValue
+    Double, ///< Floating-point literal, value in doubleValue
+    String  ///< String literal; the span includes both quotes
+};
+
+/**
+ * @brief One lexed token: its kind, interned symbol or pre-parsed value, and source span.
+ * The parser works on kinds and symbols only; the span is read back for
+ * string contents, free-form arguments and error messages.
+ */
+struct Token {
+    TokenKind kind;
+    Symbol symbol = NO_SYMBOL; ///< Names and punctuation only
+    union {
+        int intValue;
+        double doubleValue = 0.0;
+    };
+    uint32_t offset; ///< Byte offset of the first character in the source
+    uint32_t length;
+    uint32_t line;   ///< 1-based
+
+    /** @brief The token's characters in the source it was lexed from. */
+    [[nodiscard]] std::string_view text(const std::string_view source) const {
+        return source.substr(offset, length);
+    }
+};
+
+#endif //TOKEN_H